@@ -0,0 +1,14 @@
+# Throughput benchmark for "make bench".
+#
+# 262144 trips round a four-instruction loop: 1048576 instructions.
+#
+
+		.text
+		lui	$t0,0x4
+Loop:
+		addiu	$t0,$t0,-1
+		addu	$t1,$t1,$t0
+		beq	$t0,$0,Done
+		j	Loop
+Done:
+		addi	$0,$0,0 #unsupported instruction, terminate
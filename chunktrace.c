@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "computer.h"
+#include "chunktrace.h"
+#undef mips			/* gcc already has a def for mips */
+
+extern Computer mips;
+
+int recordingTrace = 0;
+
+static FILE *out;
+static unsigned char *chunk;	/* header, then records */
+static int used;		/* bytes of chunk filled */
+static int records;
+static int nextPc;		/* where the previous record left the pc */
+
+static void Put32 (unsigned char *p, unsigned int v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/* Start a chunk from the machine as it is now. */
+static void Begin () {
+    int k;
+
+    memcpy (chunk, "CHNK", 4);
+    Put32 (chunk+12, mips.instrCount);
+    Put32 (chunk+16, mips.instrCount >> 32);
+    Put32 (chunk+20, mips.pc);
+    for (k=0; k<32; k++) {
+        Put32 (chunk+24+4*k, mips.registers[k]);
+    }
+    used = CHUNKHEADER;
+    records = 0;
+    nextPc = mips.pc;
+}
+
+static void End () {
+    Put32 (chunk+4, records);
+    Put32 (chunk+8, used - CHUNKHEADER);
+    if (fwrite (chunk, used, 1, out) != 1) {
+        fprintf (stderr, "Can't write the chunk trace.\n");
+        exit (1);
+    }
+}
+
+void StartChunkTrace (char *path) {
+    unsigned char header [8];
+
+    out = fopen (path, "wb");
+    chunk = malloc (CHUNKHEADER + CHUNKRECORDS*CHUNKMAXRECORD);
+    if (out == NULL || chunk == NULL) {
+        fprintf (stderr, "Can't write chunk trace: %s\n", path);
+        exit (1);
+    }
+    memcpy (header, "MTRC", 4);
+    Put32 (header+4, CHUNKVERSION);
+    fwrite (header, 8, 1, out);
+    Begin ();
+    recordingTrace = 1;
+    /* so the last chunk is written whatever way sim stops */
+    atexit (FinishChunkTrace);
+}
+
+/* Record the instruction at pc that Step just retired. */
+void RecordStep (int pc, int changedReg, int changedMem) {
+    unsigned char *p = chunk + used, *flags = p++;
+
+    *flags = 0;
+    if (pc != nextPc) {
+        *flags |= CR_JUMP;
+        Put32 (p, pc);
+        p += 4;
+    }
+    if (changedReg != -1) {
+        *flags |= CR_REG;
+        *p++ = changedReg;
+        Put32 (p, mips.registers[changedReg]);
+        p += 4;
+    }
+    if (changedMem != -1) {
+        *flags |= CR_MEM;
+        Put32 (p, changedMem);
+        Put32 (p+4, mips.memory[(changedMem - 0x00400000) / 4]);
+        p += 8;
+    }
+    used = p - chunk;
+    nextPc = pc + 4;
+    if (++records == CHUNKRECORDS) {
+        End ();
+        Begin ();
+    }
+}
+
+void FinishChunkTrace () {
+    if (!recordingTrace) {
+        return;
+    }
+    recordingTrace = 0;		/* End may exit, which comes back here */
+    if (records > 0) {
+        End ();
+    }
+    fclose (out);
+}
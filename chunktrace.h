@@ -0,0 +1,31 @@
+
+/*
+ *  Binary trace in independently decodable chunks, for traceanalyze to
+ *  take apart in parallel.  Every instruction Step retires is a record;
+ *  CHUNKRECORDS of them make a chunk, which starts from a snapshot of
+ *  the machine so no earlier chunk is needed to decode it.
+ *
+ *  Everything is little-endian.  The file starts "MTRC" and the format
+ *  version.  Each chunk is a CHUNKHEADER-byte header: "CHNK", the number
+ *  of records, the bytes of records that follow, the number of the
+ *  instruction before the first (64 bits), the pc of the first and the
+ *  32 registers as they were before it.  Each record is a flags byte,
+ *  then the pc if CR_JUMP (otherwise it is 4 past the previous one's),
+ *  the register number as a byte and its new value if CR_REG, and the
+ *  address and new value of the word if CR_MEM.
+ */
+
+#define CHUNKVERSION 1
+#define CHUNKRECORDS 65536	/* instructions per chunk */
+#define CHUNKHEADER (4+4+4+8+4+32*4)
+#define CHUNKMAXRECORD (1+4+1+4+4+4)
+
+#define CR_JUMP 1
+#define CR_REG 2
+#define CR_MEM 4
+
+extern int recordingTrace;
+
+void StartChunkTrace (char *path);
+void RecordStep (int pc, int changedReg, int changedMem);
+void FinishChunkTrace ();
@@ -2,8 +2,19 @@
 #include <stdlib.h>
 #include <netinet/in.h>
 #include "computer.h"
+#include "decode.h"
+#include "undo.h"
+#include "input.h"
+#include "metrics.h"
+#include "memprof.h"
+#include "chunktrace.h"
+#include "filter.h"
+#include "tracebuf.h"
+#include "elf.h"
 #include "string.h"
 #include <stdint.h>
+#include <signal.h>
+#include <sys/time.h>
 #undef mips			/* gcc already has a def for mips */
 
 unsigned int endianSwap(unsigned int);
@@ -16,7 +27,9 @@ int Mem(DecodedInstr*, int, int *);
 void RegWrite(DecodedInstr*, int, int *);
 void UpdatePC(DecodedInstr*, int);
 void PrintInstruction (DecodedInstr*);
+static int Command (char *, int *);
 unsigned createMask(unsigned a, unsigned b);
+int Syscall ();
 //macro provided at: https://stackoverflow.com/questions/523724/c-c-check-if-one-bit-is-set-in-i-e-int-variable
 #define CHECK_BIT(var,pos) ((var) & (1<<(pos)))
 #define false 0
@@ -57,17 +70,55 @@ bool checkSigned(int immed){
 /*Globally accessible Computer variable*/
 Computer mips;
 RegVals rVals;
+/*Word reserved by ll, and the value read from it*/
+int llIndex = -1, llValue;
+/*Fields of every word in memory, decoded in bulk when the program is loaded*/
+DecodedImage image;
+
+/*
+ *  Read a dump of at most max little-endian words into memory with one
+ *  fread, zeroing the words after it.  Return how many words, or -1 if
+ *  there are more.
+ */
+static int LoadWords (FILE* filein, int *memory, int max) {
+    int k, n;
+    unsigned int extra;
+
+    n = fread (memory, 4, max, filein);
+    if (n == max && fread (&extra, 4, 1, filein) == 1) {
+        return -1;
+    }
+    for (k=0; k<n; k++) {
+	/*swap to big endian, convert to host byte order. Ignore this.*/
+        memory[k] = ntohl(endianSwap(memory[k]));
+    }
+    memset (memory + n, 0, (max - n) * sizeof (int));
+    return n;
+}
+
+/* Load a text dump at 0x00400000, clearing the rest of memory. */
+int LoadProgram (FILE* filein, int *memory) {
+    memset (memory + MAXNUMINSTRS, 0, MAXNUMDATA * sizeof (int));
+    return LoadWords (filein, memory, MAXNUMINSTRS);
+}
+
+/*
+ *  Load a data dump, such as MARS writes for the .data segment, at the
+ *  start of data memory (0x00400000 + 4*MAXNUMINSTRS).
+ */
+int LoadData (FILE* filein, int *memory) {
+    return LoadWords (filein, memory + MAXNUMINSTRS, MAXNUMDATA);
+}
 
 /*
  *  Return an initialized computer with the stack pointer set to the
  *  address of the end of data memory, the remaining registers initialized
- *  to zero, and the instructions read from the given file.
+ *  to zero, and memory copied from the given words.
  *  The other arguments govern how the program interacts with the user.
  */
-void InitComputer (FILE* filein, int printingRegisters, int printingMemory,
+void InitComputer (const int *memory, int printingRegisters, int printingMemory,
   int debugging, int interactive) {
     int k;
-    unsigned int instr;
 
     /* Initialize registers and memory */
 
@@ -78,96 +129,227 @@ void InitComputer (FILE* filein, int printingRegisters, int printingMemory,
     /* stack pointer - Initialize to highest address of data segment */
     mips.registers[29] = 0x00400000 + (MAXNUMINSTRS+MAXNUMDATA)*4;
 
-    for (k=0; k<MAXNUMINSTRS+MAXNUMDATA; k++) {
-        mips.memory[k] = 0;
-    }
-    
-    k = 0;
-    while (fread(&instr, 4, 1, filein)) {
-	/*swap to big endian, convert to host byte order. Ignore this.*/
-        mips.memory[k] = ntohl(endianSwap(instr));
-        k++;
-        if (k>MAXNUMINSTRS) {
-            fprintf (stderr, "Program too big.\n");
-            exit (1);
+    /* pc - the start of the code section, unless the loader says otherwise */
+    mips.pc = 0x00400000;
+
+    memcpy (mips.memory, memory, sizeof (mips.memory));
+
+    DecodeImage (mips.memory, 0, MAXNUMINSTRS+MAXNUMDATA, 0x00400000, &image);
+    if (debugging) {
+        /* Cross-check the SIMD decoder against the scalar one */
+        DecodedImage *check = malloc (sizeof (DecodedImage));
+        DecodeImageScalar (mips.memory, 0, MAXNUMINSTRS+MAXNUMDATA,
+            0x00400000, check);
+        k = CompareImages (&image, check, 0, MAXNUMINSTRS+MAXNUMDATA);
+        if (k != -1) {
+            fprintf (stderr, "Bulk decode mismatch at %8.8x\n", 0x00400000+4*k);
         }
+        free (check);
     }
 
     mips.printingRegisters = printingRegisters;
     mips.printingMemory = printingMemory;
     mips.interactive = interactive;
     mips.debugging = debugging;
+    mips.tracing = true;
+    mips.instrCount = 0;
+    mips.exitReason = EXIT_RUNNING;
+    mips.maxInstr = 0;
+    mips.textOnly = false;
+    mips.bigEndian = false;
+    mips.program = NULL;
+    mips.textLo = 0x00400000;
+    mips.textHi = 0x00400000 + MAXNUMINSTRS*4;
+    llIndex = -1;
 }
 
 unsigned int endianSwap(unsigned int i) {
     return (i>>24)|(i>>8&0x0000ff00)|(i<<8&0x00ff0000)|(i<<24);
 }
 
+/* Set by SIGALRM once the time given to StartTimeout is up */
+static volatile sig_atomic_t timedOut = 0;
+
+static void TimeUp (int sig) {
+    timedOut = 1;
+}
+
+/* Stop the simulation after the given wall-clock time. */
+void StartTimeout (double seconds) {
+    struct itimerval t;
+
+    memset (&t, 0, sizeof (t));
+    t.it_value.tv_sec = (long) seconds;
+    t.it_value.tv_usec = (long) ((seconds - (long) seconds) * 1e6);
+    signal (SIGALRM, TimeUp);
+    setitimer (ITIMER_REAL, &t, NULL);
+}
+
 /*
- *  Run the simulation.
+ *  Check the limits on a run once the instruction at pc is done, which
+ *  left the pc at nextPc, changed register changedReg of registers and
+ *  memory word changedMem (-1 for none), and made instrCount in all.
+ *  maxInstr is the budget, 0 for none.  Every engine loop calls this, so
+ *  they stop alike: return the reason to stop, or EXIT_RUNNING.  A pc of
+ *  -1 checks only the budget and the time, for steps that were many
+ *  instructions at once.
  */
-void Simulate () {
-    char s[40];  /* used for handling interactive input */
-    unsigned int instr;
-    int changedReg=-1, changedMem=-1, val;
-    DecodedInstr d;
-    
-    /* Initialize the PC to the start of the code section */
-    mips.pc = 0x00400000;
-    while (1) {
-        if (mips.interactive) {
-            printf ("> ");
-            fgets (s,sizeof(s),stdin);
-            if (s[0] == 'q') {
-                return;
-            }
+ExitReason CheckLimits (long instrCount, long maxInstr, int pc, int nextPc,
+    int changedReg, int changedMem, const int *registers, LoopState *loop) {
+    if (maxInstr > 0 && instrCount >= maxInstr) {
+        return EXIT_MAXINSTR;
+    } else if (timedOut) {
+        return EXIT_TIMEOUT;
+    } else if (pc != -1 && nextPc == pc && changedMem == -1) {
+        /* 
+         * Branched to itself.  Unless it changed a register it will do the
+         * same for ever; if it did, it will once it writes the same value.
+         */
+        if (changedReg == -1 || (pc == loop->pc && changedReg == loop->reg
+                                 && registers[changedReg] == loop->val)) {
+            return EXIT_SELFLOOP;
         }
+        loop->pc = pc;
+        loop->reg = changedReg;
+        loop->val = registers[changedReg];
+    }
+    return EXIT_RUNNING;
+}
 
-        /* Fetch instr at mips.pc, returning it in instr */
-        instr = Fetch (mips.pc);
+/* CheckLimits for Simulate.  Return 1, with the exit reason set, to stop. */
+static int Runaway (int pc, int changedReg, int changedMem) {
+    static LoopState loop = { -1, -1, 0 };
 
-	/*if(instr == 0x00000000){
-	   exit(0);
-	}*/
-        printf ("Executing instruction at %8.8x: %8.8x\n", mips.pc, instr);
+    mips.exitReason = CheckLimits (mips.instrCount, mips.maxInstr, pc, mips.pc,
+        changedReg, changedMem, mips.registers, &loop);
+    return mips.exitReason != EXIT_RUNNING;
+}
 
-        /* 
-	 * Decode instr, putting decoded instr in d
-	 * Note that we reuse the d struct for each instruction.
-	 */
-        Decode (instr, &d, &rVals);
+/* Features the Simulate loop is compiled for separately; see simloop.h */
+#define SIM_TRACE 1
+#define SIM_INTERACT 2
+#define SIM_UNDO 4
+#define SIM_PROFILE 8
+#define SIM_ALL 15
+
+#define MODE 0
+#include "simloop.h"
+#define MODE 1
+#include "simloop.h"
+#define MODE 2
+#include "simloop.h"
+#define MODE 3
+#include "simloop.h"
+#define MODE 4
+#include "simloop.h"
+#define MODE 5
+#include "simloop.h"
+#define MODE 6
+#include "simloop.h"
+#define MODE 7
+#include "simloop.h"
+#define MODE 8
+#include "simloop.h"
+#define MODE 9
+#include "simloop.h"
+#define MODE 10
+#include "simloop.h"
+#define MODE 11
+#include "simloop.h"
+#define MODE 12
+#include "simloop.h"
+#define MODE 13
+#include "simloop.h"
+#define MODE 14
+#include "simloop.h"
+#define MODE 15
+#include "simloop.h"
+
+static void (*const simulateModes [SIM_ALL+1]) (void) = {
+    SimulateMode0, SimulateMode1, SimulateMode2, SimulateMode3,
+    SimulateMode4, SimulateMode5, SimulateMode6, SimulateMode7,
+    SimulateMode8, SimulateMode9, SimulateMode10, SimulateMode11,
+    SimulateMode12, SimulateMode13, SimulateMode14, SimulateMode15
+};
+
+/* The features this run can use */
+static int SimulateMode () {
+    return (silent ? 0 : SIM_TRACE) | (mips.interactive ? SIM_INTERACT : 0)
+        | (undoLogging ? SIM_UNDO : 0) | (profiling ? SIM_PROFILE : 0);
+}
 
-        /*Print decoded instruction*/
-        PrintInstruction(&d);
+/*
+ *  Run the simulation, in the variant compiled for just the features
+ *  this run can use.
+ */
+void Simulate () {
+    simulateModes[SimulateMode ()] ();
+}
 
-        /* 
-	 * Perform computation needed to execute d, returning computed value 
-	 * in val 
-	 */
-        val = Execute(&d, &rVals);
+/* Name the variant Simulate runs, as "staged" and its features. */
+const char *SimulateModeName () {
+    static char name[40];
+    int mode = SimulateMode ();
 
-		UpdatePC(&d,val);
+    sprintf (name, "staged%s%s%s%s", mode & SIM_TRACE ? "+trace" : "",
+        mode & SIM_INTERACT ? "+interactive" : "", mode & SIM_UNDO ? "+undo" : "",
+        mode & SIM_PROFILE ? "+profile" : "");
+    return name;
+}
 
-        /* 
-	 * Perform memory load or store. Place the
-	 * address of any updated memory in *changedMem, 
-	 * otherwise put -1 in *changedMem. 
-	 * Return any memory value that is read, otherwise return -1.
-         */
-        val = Mem(&d, val, &changedMem);
+/*
+ *  Handle an interactive command other than q.  Return 1 if the command
+ *  was handled here, or 0 if the next instruction should be simulated
+ *  (just pressing Enter steps one instruction).
+ */
+static int Command (char *s, int *continuing) {
+    unsigned int addr;
+    char name[40];
+    long n = 1;
+
+    if (sscanf (s, "break %39s", name) == 1 && ParseAddress (name, &addr)) {
+        AddBreakpoint (addr);
+        printf ("Breakpoint at %8.8x\n", addr);
+        return 1;
+    }
+    if (strncmp (s, "continue", 8) == 0) {
+        *continuing = true;
+        return 0;
+    }
+    if (strncmp (s, "step-back", 9) == 0
+        || strncmp (s, "reverse-continue", 16) == 0) {
+        if (!undoLogging) {
+            printf ("No execution history; run with -u.\n");
+        } else if (s[0] == 's') {
+            sscanf (s+9, "%ld", &n);
+            StepBack (n);
+        } else {
+            ReverseContinue ();
+        }
+        return 1;
+    }
+    return 0;
+}
 
-        /* 
-	 * Write back to register. If the instruction modified a register--
-	 * (including jal, which modifies $ra) --
-         * put the index of the modified register in *changedReg,
-         * otherwise put -1 in *changedReg.
-         */
-        RegWrite(&d, val, &changedReg);
+static int breakpoints[MAXBREAKPOINTS];
+static int numBreakpoints = 0;
 
-        PrintInfo (changedReg, changedMem);
+void AddBreakpoint (int addr) {
+    if (numBreakpoints == MAXBREAKPOINTS) {
+        fprintf (stderr, "Too many breakpoints.\n");
+        return;
+    }
+    breakpoints[numBreakpoints++] = addr;
+}
 
-	
+int IsBreakpoint (int addr) {
+    int k;
+    for (k=0; k<numBreakpoints; k++) {
+        if (breakpoints[k] == addr) {
+            return true;
+        }
     }
+    return false;
 }
 
 /*
@@ -182,33 +364,48 @@ void Simulate () {
  */
 void PrintInfo ( int changedReg, int changedMem) {
     int k, addr;
-    printf ("New pc = %8.8x\n", mips.pc);
+    TraceStr ("New pc = ");
+    TraceHex (mips.pc);
+    TraceChar ('\n');
     if (!mips.printingRegisters && changedReg == -1) {
-        printf ("No register was updated.\n");
+        TraceStr ("No register was updated.\n");
     } else if (!mips.printingRegisters) {
-        printf ("Updated r%2.2d to %8.8x\n",
-        changedReg, mips.registers[changedReg]);
+        TraceStr ("Updated r");
+        TraceDec2 (changedReg);
+        TraceStr (" to ");
+        TraceHex (mips.registers[changedReg]);
+        TraceChar ('\n');
     } else {
         for (k=0; k<32; k++) {
-            printf ("r%2.2d: %8.8x  ", k, mips.registers[k]);
+            TraceChar ('r');
+            TraceDec2 (k);
+            TraceStr (": ");
+            TraceHex (mips.registers[k]);
+            TraceStr ("  ");
             if ((k+1)%4 == 0) {
-                printf ("\n");
+                TraceChar ('\n');
             }
         }
     }
     if (!mips.printingMemory && changedMem == -1) {
-        printf ("No memory location was updated.\n");
+        TraceStr ("No memory location was updated.\n");
     } else if (!mips.printingMemory) {
-        printf ("Updated memory at address %8.8x to %8.8x\n",
-        changedMem, Fetch (changedMem));
+        TraceStr ("Updated memory at address ");
+        TraceHex (changedMem);
+        TraceStr (" to ");
+        TraceHex (Fetch (changedMem));
+        TraceChar ('\n');
     } else {
-        printf ("Nonzero memory\n");
-        printf ("ADDR	  CONTENTS\n");
+        TraceStr ("Nonzero memory\n");
+        TraceStr ("ADDR	  CONTENTS\n");
         for (addr = 0x00400000+4*MAXNUMINSTRS;
              addr < 0x00400000+4*(MAXNUMINSTRS+MAXNUMDATA);
              addr = addr+4) {
             if (Fetch (addr) != 0) {
-                printf ("%8.8x  %8.8x\n", addr, Fetch (addr));
+                TraceHex (addr);
+                TraceStr ("  ");
+                TraceHex (Fetch (addr));
+                TraceChar ('\n');
             }
         }
     }
@@ -223,21 +420,14 @@ unsigned int Fetch ( int addr) {
 }
 /*Retrieves n specific bits from point a to point b*/
 unsigned createMask(unsigned a, unsigned b){
-   unsigned r = 0; 
-   for(unsigned i = a; i <= b; i++){
-      r |= 1 << i; 
-   }
-   return r; 
+   //all ones, shortened to b-a+1 bits and moved up to bit a
+   return (0xffffffffu >> (31 - (b - a))) << a; 
 }
 
 /* Decode instr, returning decoded instruction. */
 void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
     /* Your code goes here */
 
-    //opcode 
-    char o[6];
-    //funct
-    char f[6];
     unsigned r = createMask(26, 31); 
     //perfom & operation to get the bits for the opcode
     unsigned result = r & instr; 
@@ -248,9 +438,6 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
     //perform & operation to retrieve the bits for the function
     unsigned funct = r & instr;    
 
-    //store the calculated values into char* 
-    sprintf(o, "%2.2x", result);
-    sprintf(f, "%2.2x", funct);
     //printf("The instruction opcode value is %s\n", o);
     //printf("The funct/immediate value is %s\n", f);*/
 
@@ -260,7 +447,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
     */
 
     //R-format conditions
-    if(strcmp(o, "00") == 0 && strcmp(f, "21") == 0){
+    if(result == 0x00 && funct == 0x21){
 	//Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -310,7 +497,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
         //printf("addu\n");
         return; 
     }
-    else if(strcmp(o, "00") == 0 && strcmp(f, "24") == 0){
+    else if(result == 0x00 && funct == 0x24){
 	//Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -360,7 +547,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
         //printf("and\n");
         return; 
     }
-    else if(strcmp(o, "00") == 0 && strcmp(f, "08") == 0){
+    else if(result == 0x00 && funct == 0x08){
 	//Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -410,7 +597,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
         //printf("jr\n");
         return;
     }
-    else if(strcmp(o, "00") == 0 && strcmp(f, "25")==0){
+    else if(result == 0x00 && funct == 0x25){
 	//Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -459,7 +646,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
         //printf("or\n");
         return;
     }
-    else if(strcmp(o, "00") == 0 && strcmp(f, "2a")==0){
+    else if(result == 0x00 && funct == 0x2a){
 	//Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -509,7 +696,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "00") == 0 && strcmp(f, "00")==0){
+    else if(result == 0x00 && funct == 0x00){
 	//Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -559,7 +746,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "00") == 0 && strcmp(f, "02")==0){
+    else if(result == 0x00 && funct == 0x02){
 	//Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -609,7 +796,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "00") == 0 && strcmp(f, "23")==0){
+    else if(result == 0x00 && funct == 0x23){
 	//Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -660,12 +847,29 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
+    else if(result == 0x00 && funct == 0x0c){
+	//syscall has no operands, the service number is in $v0
+ 	d->op = result;
+	d->type = R;
+	d->regs.r.rs = 0;
+	d->regs.r.rt = 0;
+	d->regs.r.rd = 0;
+	d->regs.r.shamt = 0;
+	d->regs.r.funct = funct;
+
+	rVals->R_rd = 0;
+	rVals->R_rs = 0;
+	rVals->R_rt = 0;
+
+        //printf("syscall\n");
+        return;
+    }
     /*
       Using Mips Green Sheet, 
       I-format depends on the opcode
     */
     //I-format conditions
-    else if(strcmp(o, "09") == 0){
+    else if(result == 0x09){
         //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -718,7 +922,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "0c") == 0){
+    else if(result == 0x0c){
         //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -769,7 +973,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "04") == 0){
+    else if(result == 0x04){
         //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -818,7 +1022,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "05") == 0){
+    else if(result == 0x05){
         //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -867,7 +1071,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "0f") == 0){
+    else if(result == 0x0f){
         //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -918,7 +1122,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
 	return;
     }
-    else if(strcmp(o, "23") == 0){
+    else if(result == 0x23){
         //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -962,7 +1166,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "0d") == 0){
+    else if(result == 0x0d){
         //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -1015,7 +1219,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
         return;
     }
    
-    else if(strcmp(o, "2b") == 0){
+    else if(result == 0x2b){
         //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -1058,13 +1262,27 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
+    else if(result == 0x30 || result == 0x38){
+	//ll and sc have the same fields as lw and sw
+ 	d->op = result;
+        d->type = I;
+	d->regs.i.rs = (instr >> 21) & 0x1f;
+	d->regs.i.rt = (instr >> 16) & 0x1f;
+	d->regs.i.addr_or_immed = signExtension(instr);
+
+	rVals->R_rd = d->regs.i.rt;
+	rVals->R_rs = d->regs.i.rs;
+	rVals->R_rt = d->regs.i.addr_or_immed;
+
+        return;
+    }
     /*
      Using Mips Green Sheet, 
      There are only 2-J format instructions
     */ 
 
     //J-Format
-    else if(strcmp(o, "02") == 0){
+    else if(result == 0x02){
        //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -1080,7 +1298,11 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 	first_four_bits = first_four_bits & mips.pc; 
 	//Concatenating the bits
 	address = address | first_four_bits;
-        printf("Address: %8.8x\n", address);
+        if (mips.tracing) {
+	    TraceStr("Address: ");
+	    TraceHex(address);
+	    TraceChar('\n');
+	}
 	//Setting target
 	d->regs.j.target = address; 
 	//printf("%u %8.8x\n", d->op, d->regs.j.target);
@@ -1093,7 +1315,7 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
 
         return;
     }
-    else if(strcmp(o, "03") == 0){
+    else if(result == 0x03){
        //Setting the opcode
  	d->op = result;
 	//Setting the Instruction Type
@@ -1133,137 +1355,127 @@ void Decode ( unsigned int instr, DecodedInstr* d, RegVals* rVals) {
     return; 
 }
 
+/* Print " $a, $b" for an instruction's first two operands. */
+static void PrintRegPair (int a, int b) {
+    TraceStr (" $");
+    TraceUns (a);
+    TraceStr (", $");
+    TraceUns (b);
+}
+
 /*
  *  Print the disassembled version of the given instruction
  *  followed by a newline.
  */
 void PrintInstruction ( DecodedInstr* d) {
-    /* Your code goes here */
-    char o[6]; 
-    sprintf(o, "%2.2x", d->op);
-    
-    if(d->type == R){
-      //All R-format instructions have an opcode with value 0
-      //Therefore, only need to check the function
-      char f[6]; 
-      sprintf(f, "%2.2x", d->regs.r.funct);
-      if(strcmp(f, "21") == 0){
-	printf("addu $%u, $%u, $%u\n", d->regs.r.rd, d->regs.r.rs, d->regs.r.rt);
-	return;
-      }
-      if(strcmp(f, "24") == 0){
-	printf("and $%u, $%u, $%u\n", d->regs.r.rd, d->regs.r.rs, d->regs.r.rt);
-	return;
-      }
-      if(strcmp(f, "08") == 0){
-	printf("jr $%u\n", d->regs.r.rs);
-	return;
-      }
-      if(strcmp(f, "25") == 0){
-	printf("or $%u, $%u, $%u\n", d->regs.r.rd, d->regs.r.rs, d->regs.r.rt);
-	return;
-      }
-      if(strcmp(f, "2a") == 0){
-	printf("slt $%u, $%u, $%u\n", d->regs.r.rd, d->regs.r.rs, d->regs.r.rt);
-	return;
-      }
-      if(strcmp(f, "00") == 0){
-	printf("sll $%u, $%u, $%u\n", d->regs.r.rd, d->regs.r.rs, d->regs.r.rt);
-	return;
-      }
-      if(strcmp(f, "02") == 0){
-	printf("srl $%u, $%u, $%u\n", d->regs.r.rd, d->regs.r.rs, d->regs.r.rt);
-	return;
-      }
-      if(strcmp(f, "23") == 0){
-	printf("subu $%u, $%u, $%u\n", d->regs.r.rd, d->regs.r.rs, d->regs.r.rt);
-	return;
-      }	
-     
-    }
-    else if(d->type == I){
-      if(strcmp(o, "09") == 0){
-	
-	printf("addiu $%u, $%u, $%i\n", d->regs.i.rt, d->regs.i.rs, d->regs.i.addr_or_immed);
-	return;
-      }
-      if(strcmp(o, "0c") == 0){
-	
-	printf("andi $%u, $%u, $%i\n", d->regs.i.rt, d->regs.i.rs, d->regs.i.addr_or_immed);
-	return;
-      }
-      if(strcmp(o, "04") == 0){
-	
-	printf("beq $%u, $%u, $0x%8.8x\n", d->regs.i.rs, d->regs.i.rt, 
-					d->regs.i.addr_or_immed);
-	return;
-      }
-      if(strcmp(o, "05") == 0){
-	
-	printf("bne $%u, $%u, $0x%8.8x\n", d->regs.i.rs, d->regs.i.rt, 
-					d->regs.i.addr_or_immed);
-	return;
-      }
-      if(strcmp(o, "0f") == 0){
-	
-	printf("lui $%u, $%u, $0x%8.8x\n", d->regs.i.rt, d->regs.i.rs, 
-					d->regs.i.addr_or_immed);
-	return;
-      }
-      if(strcmp(o, "23") == 0){
-	
-	printf("lw $%u, $%u, $0x%8.8x\n", d->regs.i.rt, d->regs.i.rs, 
-					d->regs.i.addr_or_immed);
-	return;
-      }
-      if(strcmp(o, "0d") == 0){
-	
-	printf("ori $%u, $%u, $0x%8.8x\n", d->regs.i.rt, d->regs.i.rs, 
-					d->regs.i.addr_or_immed);
-	return;
-      }
-      if(strcmp(o, "2b") == 0){
-	
-	printf("sw $%u, $%u, $0x%8.8x\n", d->regs.i.rt, d->regs.i.rs, 
-					d->regs.i.addr_or_immed);
-	return;
-      }
-	
-      return;
-    }
-    else if(d->type == J){
+    InstrKind k;
 
-      if(strcmp(o, "02") == 0){
-	printf("j 0x%8.8x\n", d->regs.j.target);
-	return;
-      }
-      if(strcmp(o, "03") == 0){
-	printf("jal 0x%8.8x\n", d->regs.j.target);
-	return;
-      }
-      return;
-    }
-    else{
+    if(d->type == NONE){
 	//There's an unsupported instruction, so terminate as stated in the example
 	exit(0);
-	return;
     }
-    
+    k = KindOf (d->op, d->regs.r.funct);
+    TraceStr (kindNames[k]);
+    switch (k) {
+    case K_JR:
+        TraceStr (" $");
+        TraceUns (d->regs.r.rs);
+        break;
+    case K_SYSCALL:
+        break;
+    case K_J:
+    case K_JAL:
+        TraceStr (" 0x");
+        TraceHex (d->regs.j.target);
+        break;
+    case K_ADDIU:
+    case K_ANDI:
+        PrintRegPair (d->regs.i.rt, d->regs.i.rs);
+        TraceStr (", $");
+        TraceInt (d->regs.i.addr_or_immed);
+        break;
+    case K_BEQ:
+    case K_BNE:
+        //branches name rs first
+        PrintRegPair (d->regs.i.rs, d->regs.i.rt);
+        TraceStr (", $0x");
+        TraceHex (d->regs.i.addr_or_immed);
+        break;
+    case K_ORI:
+    case K_LUI:
+    case K_LW:
+    case K_SW:
+    case K_LL:
+    case K_SC:
+        PrintRegPair (d->regs.i.rt, d->regs.i.rs);
+        TraceStr (", $0x");
+        TraceHex (d->regs.i.addr_or_immed);
+        break;
+    default:
+        //the rest are R-format: rd, rs, rt
+        PrintRegPair (d->regs.r.rd, d->regs.r.rs);
+        TraceStr (", $");
+        TraceUns (d->regs.r.rt);
+        break;
+    }
+    TraceChar ('\n');
+}
+
+/*
+ *  Perform the syscall service selected by $v0: 1 print_int, 4
+ *  print_string, 5 read_int (10 exit is handled by Step).  Return the
+ *  new value of $v0.  Re-executing history prints nothing, as the
+ *  output was printed the first time.
+ */
+int Syscall () {
+    char line[40];
+    int addr, c, value;
+
+    switch (mips.registers[2]) {
+    case 1:
+        if (!undoReplaying) {
+            TraceInt (mips.registers[4]);
+        }
+        break;
+    case 4:
+        if (undoReplaying) {
+            break;
+        }
+        for (addr = mips.registers[4];
+             addr >= 0x00400000 && addr < 0x00400000+4*(MAXNUMINSTRS+MAXNUMDATA);
+             addr++) {
+            c = (Fetch (addr & ~3) >> BYTESHIFT (addr, mips.bigEndian)) & 0xff;
+            if (c == 0) {
+                break;
+            }
+            TraceChar (c);
+        }
+        break;
+    case 5:
+        if (undoReplaying) {
+            return ReplayedInput ();
+        }
+        value = 0;
+        if (ReadInput (line, sizeof(line)) != NULL) {
+            value = atoi (line);
+        }
+        if (undoLogging) {
+            LogInput (value);
+        }
+        return value;
+    }
+    return mips.registers[2];
 }
 
 /* Perform computation needed to execute d, returning computed value */
 int Execute ( DecodedInstr* d, RegVals* rVals) {
     /* Your code goes here */
     //this train of thought is most needed for execute
-    char o[6]; 
-    sprintf(o, "%2.2x", d->op);
     
     if(d->type == R){
       //All R-format instructions have an opcode with value 0
       //Therefore, only need to check the function
-      char f[6]; 
-      sprintf(f, "%2.2x", d->regs.r.funct);
-      if(strcmp(f, "21") == 0){
+      if(d->regs.r.funct == 0x21){
 	
 	//Return the computed value
 	//mips.registers[changedReg] = rVals->R_rs + rVals->R_rt; 
@@ -1277,7 +1489,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	
 	return mips.registers[a] + mips.registers[b]; 
       }
-      if(strcmp(f, "24") == 0){
+      if(d->regs.r.funct == 0x24){
 	
 	
 	//Return the computed value
@@ -1288,7 +1500,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	////printf("Rs:%u, Rt:%u\n", rVals->R_rs, rVals->R_rt);
 	return mips.registers[a] & mips.registers[b]; 
       }
-      if(strcmp(f, "08") == 0){
+      if(d->regs.r.funct == 0x08){
 	/*Not sure if this needs to be updated, but the pc will get updated to whatever 
 	  source*/
 	/*No, doesn't need to be updated*, just need to return the value stored in 
@@ -1301,11 +1513,11 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	////printf("Rs:%u, Rt:%u\n", rVals->R_rs, rVals->R_rt);
 	return mips.registers[31];  
       }
-      if(strcmp(f, "25") == 0){
+      if(d->regs.r.funct == 0x25){
 	//printf("Rs:%u, Rt:%u\n", rVals->R_rs, rVals->R_rt);
 	return mips.registers[rVals->R_rs] | mips.registers[rVals->R_rt];  
       }
-      if(strcmp(f, "29") == 0){
+      if(d->regs.r.funct == 0x29){
 	int a = 0;
 	int b = 0;
 	a = rVals->R_rs;
@@ -1313,7 +1525,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	//printf("Rs:%u, Rt:%u\n", rVals->R_rs, rVals->R_rt);
 	return (mips.registers[a] < mips.registers[b] ? 1 : 0); 
       }
-      if(strcmp(f, "00") == 0){
+      if(d->regs.r.funct == 0x00){
 	int a = 0;
 	int b = 0;
 	a = rVals->R_rs;
@@ -1321,7 +1533,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	//printf("Rs:%u, Rt:%u\n", rVals->R_rs, rVals->R_rt);
 	return mips.registers[a] << mips.registers[b]; 
       }
-      if(strcmp(f, "02") == 0){
+      if(d->regs.r.funct == 0x02){
 	int a = 0;
 	int b = 0;
 	a = rVals->R_rs;
@@ -1329,7 +1541,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	//printf("Rs:%u, Rt:%u\n", rVals->R_rs, rVals->R_rt);
 	return mips.registers[a] >> mips.registers[b];
       }	
-      if(strcmp(f, "23") == 0){
+      if(d->regs.r.funct == 0x23){
 	int a = 0;
 	int b = 0;
 	a = rVals->R_rs;
@@ -1337,10 +1549,14 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	//printf("Rs:%u, Rt:%u\n", rVals->R_rs, rVals->R_rt);
 	return mips.registers[a] - mips.registers[b];
       }		
+      if(d->regs.r.funct == 0x0c){
+	//the value returned is what goes back into $v0
+	return Syscall();
+      }
      
     }
     else if(d->type == I){
-       if(strcmp(o, "09") == 0){
+       if(d->op == 0x09){
 	 int a = 0;
 	 int imm = 0;
 	 a = rVals->R_rd;
@@ -1348,7 +1564,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	 //printf("Rs:%i, Rt:%i\n", rVals->R_rs, rVals->R_rt); 
 	 return mips.registers[a] +imm;
 	}
-	if(strcmp(o, "0c") == 0){
+	if(d->op == 0x0c){
 	 int a = 0;
 	 int imm = 0;
 	 a = rVals->R_rd;
@@ -1356,7 +1572,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	 //printf("Rs:%i, Rt:%i", rVals->R_rs, rVals->R_rt);
 	 return mips.registers[a] & imm; 
 	}
-	if(strcmp(o, "04") == 0){
+	if(d->op == 0x04){
 	 int a = 0;
 	 int b = 0;
 	 a = rVals->R_rd;
@@ -1374,7 +1590,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	
 	
 	}
-	if(strcmp(o, "05") == 0){
+	if(d->op == 0x05){
 	 int a = 0;
 	 int b = 0;
 	 a = rVals->R_rd;
@@ -1390,12 +1606,12 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 		return mips.pc;
 	 }
 	}
-	if(strcmp(o, "0f") == 0){
+	if(d->op == 0x0f){
 	
 	 //printf("Rs:%i, Rt:%i\n", rVals->R_rs, rVals->R_rt);
 	 return rVals->R_rt << 16; 
 	}
-	if(strcmp(o, "23") == 0){
+	if(d->op == 0x23){
 	 int pointer = 0;
 	 int offset = 0;
 	 pointer = rVals->R_rs;
@@ -1403,7 +1619,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	 //printf("Rs:%i, Rt:%i\n", rVals->R_rs, rVals->R_rt);
 	 return mips.registers[pointer] + offset; 
 	}
-	if(strcmp(o, "0d") == 0){
+	if(d->op == 0x0d){
 	 int a = 0;
 	 int b = 0;
 	 a = rVals->R_rs;
@@ -1411,7 +1627,7 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	 //printf("Rs:%i, Rt:%i\n", rVals->R_rs, rVals->R_rt);
 	 return mips.registers[a] | b;
 	}
-	if(strcmp(o, "2b") == 0){
+	if(d->op == 0x2b){
 	 int pointer = 0;
 	 int offset = 0;
 	 //pointer stores an address 
@@ -1423,17 +1639,21 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 	 //printf("Rs:%i, Rt:%i\n", rVals->R_rs, rVals->R_rt);
 	 return mips.registers[pointer] + offset; 
 	}
+	if(d->op == 0x30 || d->op == 0x38){
+	 //ll and sc address memory like lw and sw
+	 return mips.registers[rVals->R_rs] + rVals->R_rt;
+	}
 
     }
     else if(d->type == J){
 		// j
-      if(strcmp(o, "02") == 0  || d->op == 0x02){
+      if(d->op == 0x02){
 		//return the target address
 		//printf("%8.8x\n", rVals->R_rd);
 		return rVals->R_rd;
       }
 	  //jal
-      if(d->op == 0x03 || strcmp(o, "03") == 0){
+      if(d->op == 0x03){
 		//update return address
 		mips.registers[31] = mips.pc;
 		// printf("Register 31 during execute%8.8x\n", mips.registers[31]);
@@ -1453,31 +1673,27 @@ int Execute ( DecodedInstr* d, RegVals* rVals) {
 void UpdatePC ( DecodedInstr* d, int val) {
     
     /* Your code goes here */
-    char o[6];
-    char f[6];
-    sprintf(o, "%2.2x", d->op); 
-    sprintf(f, "%2.2x", d->regs.r.funct);
 
 	//printf("%s\n", o);
-    if(strcmp(o, "04") == 0 || d->op == 0x04){
+    if(d->op == 0x04){
 	//beq
 	//printf("Rs:%i, Rt:%i", rVals->R_rs, rVals->R_rt);
 	mips.pc = val; 
 	return;
     }
-    else if(strcmp(o, "05") == 0 || d->op == 0x05){
+    else if(d->op == 0x05){
 	//bne
 	//printf("pc = %8.8x", val);
 	mips.pc = val + 4; 
 	return;
     }
-    else if(strcmp(o, "02") == 0 || d->op == 0x02){
+    else if(d->op == 0x02){
 	//j
 	//printf("Rs:%i, Rt:%i", rVals->R_rs, rVals->R_rt);
 	mips.pc = val; 
 	return;
     }
-    else if(strcmp(o, "03") == 0 || d->op == 0x03){
+    else if(d->op == 0x03){
 	//jal
 	//printf("Rs:%i, Rt:%i", rVals->R_rs, rVals->R_rt);
 	//printf("hello %d\n", val);
@@ -1485,7 +1701,7 @@ void UpdatePC ( DecodedInstr* d, int val) {
 	mips.pc = val;
 	return;
     }
-    else if(strcmp(o, "00") == 0 && strcmp(f, "08") == 0 || d->op == 0x00 && d->regs.r.funct == 0x08){
+    else if(d->op == 0x00 && d->regs.r.funct == 0x08){
 	//jr
 	//printf("Rs:%i, Rt:%i", rVals->R_rs, rVals->R_rt);
 	//printf("r31 is %8.8x\n", val); 
@@ -1521,7 +1737,10 @@ int Mem( DecodedInstr* d, int val, int *changedMem) {
 	//lw doesn't update any values in memory, therefore changedMem is not updated
 	*changedMem = -1;
 	int index = (val - 0x00400000)/4;
-	printf("%d\n", index);
+	if (mips.tracing) {
+		TraceInt(index);
+		TraceChar('\n');
+	}
 	return mips.memory[index];
   }
   //sw
@@ -1536,7 +1755,7 @@ int Mem( DecodedInstr* d, int val, int *changedMem) {
 	//*changedMem = (val - 0x00401000)/4;
 	*changedMem = val;
 	//printf("CHANGED MEM%8.8x", *changedMem);
-	if(*changedMem >= 0x00400000 && *changedMem <= 0x00404000){
+	if(INIMAGE (*changedMem)){
 		//printf("Memory location of mips.memory: %8.8x, Memory location of changedMem: %8.8x\n", 0x00401000, *changedMem);
 		int index = (*changedMem - 0x00400000)/4;
 		//printf("val: %i\n", index);
@@ -1548,6 +1767,31 @@ int Mem( DecodedInstr* d, int val, int *changedMem) {
 	
 	return 0; 
   }
+  //ll
+  if(d->op == 0x30){
+	//reserve the word, remembering what was read from it
+	*changedMem = -1;
+	llIndex = (val - 0x00400000)/4;
+	if(llIndex < 0 || llIndex >= MAXNUMINSTRS+MAXNUMDATA){
+		llIndex = -1;
+		return 0;
+	}
+	llValue = mips.memory[llIndex];
+	return llValue;
+  }
+  //sc
+  if(d->op == 0x38){
+	//store only if the reserved word still holds what ll read, and
+	//return 1 for success or 0 for failure, which goes into rt
+	int index = (val - 0x00400000)/4;
+	*changedMem = -1;
+	if(index == llIndex && index >= 0 && mips.memory[index] == llValue){
+		*changedMem = val;
+		mips.memory[index] = mips.registers[d->regs.i.rt];
+	}
+	llIndex = -1;
+	return *changedMem != -1;
+  }
  
   //if no MEM cycle is needed, just return the val
   *changedMem = -1;
@@ -1607,6 +1851,12 @@ void RegWrite( DecodedInstr* d, int val, int *changedReg) {
 		mips.registers[*changedReg] = val;
 		return;
 	}
+	if(d->regs.r.funct == 0x0c && mips.registers[2] == 5){
+		//syscall read_int puts the value read in $v0
+		*changedReg = 2;
+		mips.registers[*changedReg] = val;
+		return;
+	}
 	
 	//jr was executed, and doesn't update any registers
 	*changedReg = -1;
@@ -1648,6 +1898,12 @@ void RegWrite( DecodedInstr* d, int val, int *changedReg) {
 		mips.registers[*changedReg] = val;
 		return;
 	}
+	if(d->op == 0x30 || d->op == 0x38){
+		//ll, and sc's success flag
+		*changedReg = d->regs.i.rt;
+		mips.registers[*changedReg] = val;
+		return;
+	}
 	//executed beq, bne, or sw
 	*changedReg = -1;
 	return;
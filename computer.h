@@ -1,15 +1,38 @@
 
 #define MAXNUMINSTRS 1024	/* max # instrs in a program */
 #define MAXNUMDATA 3072		/* max # data words */
+#define MAXBREAKPOINTS 64	/* max # interactive breakpoints */
+
+/* Why a simulation stopped */
+typedef enum {
+    EXIT_RUNNING=0, EXIT_UNSUPPORTED, EXIT_SYSCALL, EXIT_QUIT,
+    EXIT_MAXINSTR, EXIT_PCRANGE, EXIT_SELFLOOP, EXIT_TIMEOUT, NUMEXITREASONS
+} ExitReason;
 
 struct SimulatedComputer {
     int memory [MAXNUMINSTRS+MAXNUMDATA];
     int registers [32];
     int pc;
+    long instrCount;	/* instructions simulated so far */
     int printingRegisters, printingMemory, interactive, debugging;
+    int tracing;	/* the instruction being simulated is to be traced */
+    ExitReason exitReason;
+    long maxInstr;	/* stop after this many instructions, 0 for no limit */
+    int textOnly;	/* stop if the pc leaves [textLo, textHi) */
+    int textLo, textHi;	/* addresses of the loaded code */
+    int bigEndian;	/* bytes of a word are in big-endian order */
+    const struct ElfProgram *program;	/* for its symbols, or NULL */
 };
 typedef struct SimulatedComputer Computer;
 
+/* How far byte addr is shifted up within its word of memory */
+#define BYTESHIFT(addr, bigEndian) (8*((bigEndian) ? 3 - ((addr) & 3) : (addr) & 3))
+
+/* A branch to itself that changed a register, see CheckLimits */
+typedef struct {
+    int pc, reg, val;
+} LoopState;
+
 typedef enum { R=0, I, J, NONE } InstrType;
 
 typedef struct {
@@ -46,6 +69,15 @@ typedef struct {
   int R_rd;
 } RegVals;
 
-void InitComputer (FILE*, int printingRegisters, int printingMemory,
+int LoadProgram (FILE*, int *memory);
+int LoadData (FILE*, int *memory);
+void InitComputer (const int *memory, int printingRegisters, int printingMemory,
     int debugging, int interactive);
 void Simulate ();
+const char *SimulateModeName ();
+void StartTimeout (double seconds);
+ExitReason CheckLimits (long instrCount, long maxInstr, int pc, int nextPc,
+    int changedReg, int changedMem, const int *registers, LoopState *loop);
+int Step (int *changedReg, int *changedMem);
+void AddBreakpoint (int addr);
+int IsBreakpoint (int addr);
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include "computer.h"
+#include "decode.h"
+#include "superops.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const char *kindNames[NUMKINDS] = {
+    "addu", "and", "or", "subu", "slt", "sll", "srl", "jr", "syscall",
+    "addiu", "andi", "ori", "lui", "beq", "bne", "lw", "sw", "ll", "sc",
+    "j", "jal", "unsupported"
+};
+
+/* Which instruction an opcode and funct field make. */
+InstrKind KindOf (int op, int funct) {
+    switch (op) {
+    case 0x00:
+        switch (funct) {
+        case 0x21: return K_ADDU;
+        case 0x24: return K_AND;
+        case 0x25: return K_OR;
+        case 0x23: return K_SUBU;
+        case 0x2a: return K_SLT;
+        case 0x00: return K_SLL;
+        case 0x02: return K_SRL;
+        case 0x08: return K_JR;
+        case 0x0c: return K_SYSCALL;
+        }
+        return K_UNSUPPORTED;
+    case 0x09: return K_ADDIU;
+    case 0x0c: return K_ANDI;
+    case 0x0d: return K_ORI;
+    case 0x0f: return K_LUI;
+    case 0x04: return K_BEQ;
+    case 0x05: return K_BNE;
+    case 0x23: return K_LW;
+    case 0x2b: return K_SW;
+    case 0x30: return K_LL;
+    case 0x38: return K_SC;
+    case 0x02: return K_J;
+    case 0x03: return K_JAL;
+    }
+    return K_UNSUPPORTED;
+}
+
+/*
+ *  Decode a single word into slot k of img.  This is the reference for
+ *  what every field means; the SIMD path below has to agree with it.
+ */
+static void DecodeWord (unsigned int instr, int k, int pc, DecodedImage *img) {
+    img->op[k] = instr >> 26;
+    img->rs[k] = (instr >> 21) & 0x1f;
+    img->rt[k] = (instr >> 16) & 0x1f;
+    img->rd[k] = (instr >> 11) & 0x1f;
+    img->shamt[k] = (instr >> 6) & 0x1f;
+    img->funct[k] = instr & 0x3f;
+    img->immed[k] = (int)(short)(instr & 0xffff);
+    img->target[k] = ((instr & 0x03ffffff) << 2) | (pc & 0xf0000000);
+}
+
+#define K_NONE NUMKINDS		/* pads a pair to three kinds */
+#define SUPERKINDS(n, length, a, b, c) { length, { K_##a, K_##b, K_##c } },
+
+static const struct {
+    int length;
+    InstrKind kinds[3];
+} superKinds[NUMSUPEROPS+1] = {
+    SUPEROPS (SUPERKINDS)
+};
+
+/*
+ *  Set img->super for the slots from first-2 to first+count-1 to the
+ *  longest superinstruction whose kinds start there, earlier in the
+ *  table winning a tie.
+ */
+static void MarkSuperops (DecodedImage *img, int first, int count) {
+    int k, j, n, best;
+
+    for (k = first > 2 ? first-2 : 0; k<first+count && k<IMAGEWORDS; k++) {
+        best = -1;
+        for (n=0; n<NUMSUPEROPS; n++) {
+            if (k + superKinds[n].length > IMAGEWORDS
+                || (best != -1 && superKinds[n].length <= superKinds[best].length)) {
+                continue;
+            }
+            for (j=0; j<superKinds[n].length
+                 && KindOf (img->op[k+j], img->funct[k+j]) == superKinds[n].kinds[j]; j++) {
+            }
+            if (j == superKinds[n].length) {
+                best = n;
+            }
+        }
+        img->super[k] = best + 1;
+    }
+}
+
+static void DecodeWords (const int *words, int first, int count, int basePc,
+    DecodedImage *img) {
+    int k;
+
+    for (k=first; k<first+count; k++) {
+        DecodeWord (words[k], k, basePc + 4*k, img);
+    }
+}
+
+void DecodeImageScalar (const int *words, int first, int count, int basePc,
+    DecodedImage *img) {
+    DecodeWords (words, first, count, basePc, img);
+    MarkSuperops (img, first, count);
+}
+
+/*
+ *  Decode word, just stored at index k, without reading memory again:
+ *  another hart may be storing there too.
+ */
+void DecodeStored (int word, int k, int basePc, DecodedImage *img) {
+    DecodeWord (word, k, basePc + 4*k, img);
+    MarkSuperops (img, k, 1);
+}
+
+#if defined(__SSE2__)
+/* Narrow two vectors of small 32-bit fields to 8 bytes and store them. */
+static void StoreBytes (unsigned char *dst, __m128i lo, __m128i hi) {
+    __m128i w = _mm_packs_epi32 (lo, hi);
+    _mm_storel_epi64 ((__m128i *) dst, _mm_packus_epi16 (w, w));
+}
+
+/*
+ *  Decode 8 words per iteration as two 4-lane vectors.  Whatever does not
+ *  fill a whole group of 8 is left to the scalar decoder.
+ */
+void DecodeImage (const int *words, int first, int count, int basePc,
+    DecodedImage *img) {
+    const __m128i m5 = _mm_set1_epi32 (0x1f);
+    const __m128i m6 = _mm_set1_epi32 (0x3f);
+    const __m128i m26 = _mm_set1_epi32 (0x03ffffff);
+    const __m128i top = _mm_set1_epi32 ((int) 0xf0000000);
+    const __m128i step = _mm_set_epi32 (12, 8, 4, 0);
+    int k, end = first + (count & ~7);
+
+    for (k=first; k<end; k+=8) {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (words + k));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (words + k + 4));
+        __m128i pcA = _mm_add_epi32 (_mm_set1_epi32 (basePc + 4*k), step);
+        __m128i pcB = _mm_add_epi32 (_mm_set1_epi32 (basePc + 4*k + 16), step);
+
+        StoreBytes (img->op + k, _mm_srli_epi32 (a, 26), _mm_srli_epi32 (b, 26));
+        StoreBytes (img->rs + k, _mm_and_si128 (_mm_srli_epi32 (a, 21), m5),
+            _mm_and_si128 (_mm_srli_epi32 (b, 21), m5));
+        StoreBytes (img->rt + k, _mm_and_si128 (_mm_srli_epi32 (a, 16), m5),
+            _mm_and_si128 (_mm_srli_epi32 (b, 16), m5));
+        StoreBytes (img->rd + k, _mm_and_si128 (_mm_srli_epi32 (a, 11), m5),
+            _mm_and_si128 (_mm_srli_epi32 (b, 11), m5));
+        StoreBytes (img->shamt + k, _mm_and_si128 (_mm_srli_epi32 (a, 6), m5),
+            _mm_and_si128 (_mm_srli_epi32 (b, 6), m5));
+        StoreBytes (img->funct + k, _mm_and_si128 (a, m6),
+            _mm_and_si128 (b, m6));
+
+        _mm_storeu_si128 ((__m128i *) (img->immed + k),
+            _mm_srai_epi32 (_mm_slli_epi32 (a, 16), 16));
+        _mm_storeu_si128 ((__m128i *) (img->immed + k + 4),
+            _mm_srai_epi32 (_mm_slli_epi32 (b, 16), 16));
+
+        _mm_storeu_si128 ((__m128i *) (img->target + k),
+            _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (a, m26), 2),
+                _mm_and_si128 (pcA, top)));
+        _mm_storeu_si128 ((__m128i *) (img->target + k + 4),
+            _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (b, m26), 2),
+                _mm_and_si128 (pcB, top)));
+    }
+    DecodeWords (words, end, first + count - end, basePc, img);
+    MarkSuperops (img, first, count);
+}
+#else
+void DecodeImage (const int *words, int first, int count, int basePc,
+    DecodedImage *img) {
+    DecodeImageScalar (words, first, count, basePc, img);
+}
+#endif
+
+/*
+ *  Return the index of the first slot in [first, first+count) where the
+ *  two images disagree, or -1 if they match.
+ */
+int CompareImages (const DecodedImage *a, const DecodedImage *b,
+    int first, int count) {
+    int k;
+
+    for (k=first; k<first+count; k++) {
+        if (a->op[k] != b->op[k] || a->rs[k] != b->rs[k]
+            || a->rt[k] != b->rt[k] || a->rd[k] != b->rd[k]
+            || a->shamt[k] != b->shamt[k] || a->funct[k] != b->funct[k]
+            || a->immed[k] != b->immed[k] || a->target[k] != b->target[k]
+            || a->super[k] != b->super[k]) {
+            return k;
+        }
+    }
+    return -1;
+}
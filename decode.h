@@ -0,0 +1,49 @@
+
+/*
+ *  Bulk decoder.  Splits a run of instruction words into their fields
+ *  once, at load time, so the simulator does not have to pull them apart
+ *  again on every fetch.  Fields are kept struct-of-arrays, indexed by
+ *  word (mips.memory index), so they can be filled 8 words at a time.
+ */
+
+#define IMAGEWORDS (MAXNUMINSTRS+MAXNUMDATA)
+
+/* Whether a store to addr lands in the simulated memory */
+#define INIMAGE(addr) ((addr) >= 0x00400000 && (addr) < 0x00400000 + 4*IMAGEWORDS)
+
+typedef struct {
+  unsigned char op[IMAGEWORDS];
+  unsigned char rs[IMAGEWORDS];
+  unsigned char rt[IMAGEWORDS];
+  unsigned char rd[IMAGEWORDS];
+  unsigned char shamt[IMAGEWORDS];
+  unsigned char funct[IMAGEWORDS];
+  int immed[IMAGEWORDS];	/* sign-extended 16-bit immediate */
+  int target[IMAGEWORDS];	/* absolute j/jal target */
+  unsigned char super[IMAGEWORDS];	/* 1 + superinstruction starting here, or 0 */
+} DecodedImage;
+
+/* Every instruction the simulator supports, plus one for the rest */
+typedef enum {
+  K_ADDU=0, K_AND, K_OR, K_SUBU, K_SLT, K_SLL, K_SRL, K_JR, K_SYSCALL,
+  K_ADDIU, K_ANDI, K_ORI, K_LUI, K_BEQ, K_BNE, K_LW, K_SW, K_LL, K_SC,
+  K_J, K_JAL, K_UNSUPPORTED, NUMKINDS
+} InstrKind;
+
+extern const char *kindNames[NUMKINDS];
+
+/*
+ *  Decode words[first] .. words[first+count-1] into the same slots of img.
+ *  basePc is the address of words[0].  DecodeImage uses SIMD where the
+ *  host has it; DecodeImageScalar gives identical results on any host.
+ *  Both then mark where the superinstructions of superops.h start, in
+ *  every slot whose sequence the new words belong to.
+ */
+void DecodeImage (const int *words, int first, int count, int basePc,
+    DecodedImage *img);
+void DecodeImageScalar (const int *words, int first, int count, int basePc,
+    DecodedImage *img);
+void DecodeStored (int word, int k, int basePc, DecodedImage *img);
+InstrKind KindOf (int op, int funct);
+int CompareImages (const DecodedImage *a, const DecodedImage *b,
+    int first, int count);
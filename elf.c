@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "computer.h"
+#include "elf.h"
+#undef mips			/* gcc already has a def for mips */
+
+extern Computer mips;
+
+#define PT_LOAD 1
+#define PF_X 1
+#define SHT_SYMTAB 2
+#define EM_MIPS 8
+
+/* Fields of the executable, in its own byte order */
+static unsigned int Half (const ElfProgram *elf, const unsigned char *p) {
+    return elf->bigEndian ? p[0]<<8 | p[1] : p[1]<<8 | p[0];
+}
+
+static unsigned int Word (const ElfProgram *elf, const unsigned char *p) {
+    return elf->bigEndian ? (unsigned)p[0]<<24 | p[1]<<16 | p[2]<<8 | p[3]
+        : (unsigned)p[3]<<24 | p[2]<<16 | p[1]<<8 | p[0];
+}
+
+int IsElf (const unsigned char *bytes, long length) {
+    return length >= 4 && memcmp (bytes, "\177ELF", 4) == 0;
+}
+
+static int CompareSymbols (const void *a, const void *b) {
+    const Symbol *x = a, *y = b;
+    return (x->value > y->value) - (x->value < y->value);
+}
+
+void FreeSymbols (ElfProgram *elf) {
+    int k;
+
+    for (k=0; k<elf->numSymbols; k++) {
+        free (elf->symbols[k].name);
+    }
+    free (elf->symbols);
+    elf->symbols = NULL;
+    elf->numSymbols = 0;
+}
+
+/*
+ *  Give to a copy of the symbols of from, for a machine cloned from
+ *  another.  Return 0, or -1 if out of memory.
+ */
+int CopySymbols (ElfProgram *to, const ElfProgram *from) {
+    int k;
+
+    to->symbols = malloc ((from->numSymbols + 1) * sizeof (Symbol));
+    to->numSymbols = 0;
+    if (to->symbols == NULL) {
+        return -1;
+    }
+    for (k=0; k<from->numSymbols; k++) {
+        to->symbols[k].name = strdup (from->symbols[k].name);
+        to->symbols[k].value = from->symbols[k].value;
+        if (to->symbols[k].name == NULL) {
+            FreeSymbols (to);
+            return -1;
+        }
+        to->numSymbols++;
+    }
+    return 0;
+}
+
+/* Keep the named functions and objects of the first symbol table. */
+static void ReadSymbols (const unsigned char *bytes, long length, ElfProgram *elf) {
+    unsigned int shoff = Word (elf, bytes+32), shentsize = Half (elf, bytes+46);
+    unsigned int shnum = Half (elf, bytes+48);
+    const unsigned char *sh, *link, *sym;
+    unsigned int k, off, size, strOff, strSize, name;
+
+    FreeSymbols (elf);
+    if (shoff == 0 || shoff + (long) shnum * shentsize > length) {
+        return;
+    }
+    for (k=0; k<shnum; k++) {
+        sh = bytes + shoff + k*shentsize;
+        if (Word (elf, sh+4) == SHT_SYMTAB && Word (elf, sh+24) < shnum) {
+            break;
+        }
+    }
+    if (k == shnum) {
+        return;
+    }
+    off = Word (elf, sh+16);
+    size = Word (elf, sh+20);
+    link = bytes + shoff + Word (elf, sh+24)*shentsize;
+    strOff = Word (elf, link+16);
+    strSize = Word (elf, link+20);
+    if ((long) off + size > length || (long) strOff + strSize > length) {
+        return;
+    }
+    elf->symbols = malloc ((size/16 + 1) * sizeof (Symbol));
+    for (k=0; elf->symbols != NULL && k+16<=size; k+=16) {
+        sym = bytes + off + k;
+        name = Word (elf, sym);
+        /* named, defined, and a function, an object or untyped (a label) */
+        if (name != 0 && name < strSize && Half (elf, sym+14) != 0
+            && (sym[12] & 0xf) <= 2) {
+            elf->symbols[elf->numSymbols].name = strndup (
+                (const char *) bytes + strOff + name, strSize - name);
+            elf->symbols[elf->numSymbols].value = Word (elf, sym+4);
+            elf->numSymbols++;
+        }
+    }
+    qsort (elf->symbols, elf->numSymbols, sizeof (Symbol), CompareSymbols);
+}
+
+/*
+ *  Load the executable in bytes into memory, which is cleared first, and
+ *  fill in elf: the entry point, text[0] .. text[1] as the addresses the
+ *  executable segments cover (all of memory if none is marked so), the
+ *  byte order and the symbols.  Return 0, or -1 with elf->error set.
+ *  Words keep their value whichever the byte order; a single byte is
+ *  found with BYTESHIFT and elf->bigEndian.
+ */
+int LoadElf (const unsigned char *bytes, long length, int *memory, ElfProgram *elf) {
+    unsigned int phoff, phentsize, phnum, off, vaddr, filesz, memsz, a, k;
+    const unsigned char *ph;
+    int shift;
+
+    if (!IsElf (bytes, length) || length < 52 || bytes[4] != 1
+        || (bytes[5] != 1 && bytes[5] != 2)) {
+        elf->error = "not an ELF32 file";
+        return -1;
+    }
+    elf->bigEndian = bytes[5] == 2;
+    if (Half (elf, bytes+18) != EM_MIPS) {
+        elf->error = "not a MIPS executable";
+        return -1;
+    }
+    phoff = Word (elf, bytes+28);
+    phentsize = Half (elf, bytes+42);
+    phnum = Half (elf, bytes+44);
+    if ((long) phoff + (long) phnum * phentsize > length) {
+        elf->error = "truncated program headers";
+        return -1;
+    }
+
+    memset (memory, 0, (MAXNUMINSTRS+MAXNUMDATA) * sizeof (int));
+    elf->text[0] = 0x00400000 + (MAXNUMINSTRS+MAXNUMDATA)*4;
+    elf->text[1] = 0x00400000;
+    for (k=0; k<phnum; k++) {
+        ph = bytes + phoff + k*phentsize;
+        if (Word (elf, ph) != PT_LOAD) {
+            continue;
+        }
+        off = Word (elf, ph+4);
+        vaddr = Word (elf, ph+8);
+        filesz = Word (elf, ph+16);
+        memsz = Word (elf, ph+20);
+        if (vaddr < 0x00400000 || memsz > (MAXNUMINSTRS+MAXNUMDATA)*4
+            || vaddr - 0x00400000 + memsz > (MAXNUMINSTRS+MAXNUMDATA)*4) {
+            elf->error = "segment outside simulated memory";
+            return -1;
+        }
+        if (filesz > memsz || (long) off + filesz > length) {
+            elf->error = "truncated segment";
+            return -1;
+        }
+        if (Word (elf, ph+24) & PF_X) {
+            elf->text[0] = vaddr < elf->text[0] ? vaddr : elf->text[0];
+            elf->text[1] = vaddr + memsz > elf->text[1]
+                ? vaddr + memsz : elf->text[1];
+        }
+        /* the rest of memsz is bss, already cleared */
+        for (a=0; a<filesz; a++) {
+            shift = BYTESHIFT (vaddr+a, elf->bigEndian);
+            memory[(vaddr+a-0x00400000)/4] |= bytes[off+a] << shift;
+        }
+    }
+    if (elf->text[0] >= elf->text[1]) {
+        elf->text[0] = 0x00400000;
+        elf->text[1] = 0x00400000 + (MAXNUMINSTRS+MAXNUMDATA)*4;
+    }
+    elf->entry = Word (elf, bytes+24);
+    ReadSymbols (bytes, length, elf);
+    return 0;
+}
+
+/*
+ *  Load an executable file.  It is mapped private and read-only rather
+ *  than read into a buffer, so only the pages the segments and symbol
+ *  table occupy are ever touched.  Return as LoadElf, or -2 if the file
+ *  can't be opened.
+ */
+int LoadElfFile (const char *path, int *memory, ElfProgram *elf) {
+    struct stat st;
+    void *map;
+    int fd, result;
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        return -2;
+    }
+    if (fstat (fd, &st) != 0 || st.st_size == 0) {
+        close (fd);
+        elf->error = "empty file";
+        return -1;
+    }
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        elf->error = "can't map file";
+        return -1;
+    }
+    result = LoadElf (map, st.st_size, memory, elf);
+    munmap (map, st.st_size);
+    return result;
+}
+
+/* Set *value to the address of the named symbol.  Return 0 if unknown. */
+int LookupSymbol (const ElfProgram *elf, const char *name, int *value) {
+    int k;
+
+    for (k=0; k<elf->numSymbols; k++) {
+        if (strcmp (elf->symbols[k].name, name) == 0) {
+            *value = elf->symbols[k].value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Name of a symbol at exactly addr, or NULL. */
+const char *SymbolAt (const ElfProgram *elf, int addr) {
+    int lo = 0, hi = elf->numSymbols;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (elf->symbols[mid].value < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < elf->numSymbols && elf->symbols[lo].value == addr
+        ? elf->symbols[lo].name : NULL;
+}
+
+/*
+ *  An address given in hex or as a symbol of the program the staged
+ *  simulator runs.  Return 0 if it is neither.
+ */
+int ParseAddress (const char *s, unsigned int *addr) {
+    int value;
+    char end;
+
+    if (mips.program != NULL && LookupSymbol (mips.program, s, &value)) {
+        *addr = value;
+        return 1;
+    }
+    return sscanf (s, "%x%c", addr, &end) == 1;
+}
@@ -0,0 +1,32 @@
+/*
+ *  ELF32 MIPS executables, big- or little-endian.  PT_LOAD segments are
+ *  placed at their virtual addresses, which must lie in simulated memory
+ *  (0x00400000 up to MAXNUMINSTRS+MAXNUMDATA words on).  What else the
+ *  load finds -- the entry point, the span of the executable segments,
+ *  the byte order and the function and object symbols -- goes in an
+ *  ElfProgram that belongs to the machine it was loaded into, so
+ *  addresses can be given by name and traces can be labelled.
+ */
+
+typedef struct {
+    char *name;
+    int value;
+} Symbol;
+
+typedef struct ElfProgram {
+    int entry;
+    int text [2];	/* span of the executable segments */
+    int bigEndian;	/* byte order of the executable */
+    Symbol *symbols;	/* sorted by value */
+    int numSymbols;
+    const char *error;	/* why the last load failed */
+} ElfProgram;
+
+int IsElf (const unsigned char *bytes, long length);
+int LoadElf (const unsigned char *bytes, long length, int *memory, ElfProgram *elf);
+int LoadElfFile (const char *path, int *memory, ElfProgram *elf);
+void FreeSymbols (ElfProgram *elf);
+int CopySymbols (ElfProgram *to, const ElfProgram *from);
+int LookupSymbol (const ElfProgram *elf, const char *name, int *value);
+const char *SymbolAt (const ElfProgram *elf, int addr);
+int ParseAddress (const char *s, unsigned int *addr);
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "computer.h"
+#include "decode.h"
+#include "engine.h"
+#include "input.h"
+#include "plugin.h"
+#include "superops.h"
+
+#define INDEX(addr) (((addr) - 0x00400000) / 4)
+#define INRANGE(k) ((k) >= 0 && (k) < IMAGEWORDS)
+
+static pthread_mutex_t inputLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ *  Immediate as the staged pipeline uses it for addiu, andi, ori and lui:
+ *  Decode's complement() turns a negative immediate other than -1 into
+ *  one more than itself.
+ */
+static int StagedImmed (int immed) {
+    return (immed < 0 && immed != -1) ? immed + 1 : immed;
+}
+
+/* Return the word at memory index k, or 0 outside memory. */
+static int Load (int *memory, int k) {
+    return INRANGE (k) ? __atomic_load_n (&memory[k], __ATOMIC_RELAXED) : 0;
+}
+
+/* Store a word, keeping the decoded image in step with memory. */
+static void Store (int *memory, DecodedImage *img, int k, int val) {
+    if (INRANGE (k)) {
+        __atomic_store_n (&memory[k], val, __ATOMIC_RELAXED);
+        DecodeStored (val, k, 0x00400000, img);
+    }
+}
+
+/* Same services as Syscall() in computer.c.  Returns the new $v0. */
+static int HartSyscall (Hart *h, int *memory) {
+    char line[40];
+    int addr, c, value = 0;
+    FILE *out = h->out != NULL ? h->out : stdout;
+
+    switch (h->registers[2]) {
+    case 1:
+        fprintf (out, "%d", h->registers[4]);
+        break;
+    case 4:
+        for (addr = h->registers[4]; INRANGE (INDEX (addr)); addr++) {
+            c = (Load (memory, INDEX (addr & ~3))
+                >> BYTESHIFT (addr, h->bigEndian)) & 0xff;
+            if (c == 0) {
+                break;
+            }
+            putc (c, out);
+        }
+        break;
+    case 5:
+        if (h->in != NULL) {
+            return fgets (line, sizeof(line), h->in) != NULL ? atoi (line) : 0;
+        }
+        pthread_mutex_lock (&inputLock);
+        if (ReadInput (line, sizeof(line)) != NULL) {
+            value = atoi (line);
+        }
+        pthread_mutex_unlock (&inputLock);
+        return value;
+    }
+    return h->registers[2];
+}
+
+/*
+ *  Simulate the instruction at h->pc.  Return 0 without changing anything
+ *  if it is unsupported or a syscall exit, otherwise 1.  *changedReg and
+ *  *changedMem are set as Simulate() sets them.  StepHart calls no plugin;
+ *  StepHooked01 .. StepHooked77 call those for the events in their octal
+ *  suffix.
+ */
+#define HI 0
+#include "stepvariants.h"
+#undef HI
+#define HI 1
+#include "stepvariants.h"
+#undef HI
+#define HI 2
+#include "stepvariants.h"
+#undef HI
+#define HI 3
+#include "stepvariants.h"
+#undef HI
+#define HI 4
+#include "stepvariants.h"
+#undef HI
+#define HI 5
+#include "stepvariants.h"
+#undef HI
+#define HI 6
+#include "stepvariants.h"
+#undef HI
+#define HI 7
+#include "stepvariants.h"
+#undef HI
+
+static const StepFn hookedSteps [NUMHOOKMASKS] = {
+    StepHart, StepHooked01, StepHooked02, StepHooked03,
+    StepHooked04, StepHooked05, StepHooked06, StepHooked07,
+    StepHooked10, StepHooked11, StepHooked12, StepHooked13,
+    StepHooked14, StepHooked15, StepHooked16, StepHooked17,
+    StepHooked20, StepHooked21, StepHooked22, StepHooked23,
+    StepHooked24, StepHooked25, StepHooked26, StepHooked27,
+    StepHooked30, StepHooked31, StepHooked32, StepHooked33,
+    StepHooked34, StepHooked35, StepHooked36, StepHooked37,
+    StepHooked40, StepHooked41, StepHooked42, StepHooked43,
+    StepHooked44, StepHooked45, StepHooked46, StepHooked47,
+    StepHooked50, StepHooked51, StepHooked52, StepHooked53,
+    StepHooked54, StepHooked55, StepHooked56, StepHooked57,
+    StepHooked60, StepHooked61, StepHooked62, StepHooked63,
+    StepHooked64, StepHooked65, StepHooked66, StepHooked67,
+    StepHooked70, StepHooked71, StepHooked72, StepHooked73,
+    StepHooked74, StepHooked75, StepHooked76, StepHooked77,
+};
+
+/* The step function for the events the loaded plugins subscribe to. */
+StepFn SelectStep (void) {
+    return hookedSteps[hookMask];
+}
+
+/* Why StepHart refused the instruction at pc. */
+ExitReason StopReason (DecodedImage *img, int pc) {
+    int k = INDEX (pc);
+
+    if (!INRANGE (k)) {
+        return EXIT_PCRANGE;
+    } else if (img->op[k] == 0x00 && img->funct[k] == 0x0c) {
+        return EXIT_SYSCALL;
+    }
+    return EXIT_UNSUPPORTED;
+}
+
+/*
+ *  Fused handlers for the superinstructions of superops.h.  Each runs
+ *  its instructions as StepHart would, straight through: only the last
+ *  may branch or store, and none is a syscall, ll, sc or jal, so nothing
+ *  can stop the sequence or change the words still to run.
+ */
+int fusing = 1;
+
+#define RS(i) r[img->rs[k+(i)]]
+#define RT(i) r[img->rt[k+(i)]]
+#define RD(i) r[img->rd[k+(i)]]
+#define IMMED(i) img->immed[k+(i)]
+
+#define OP_NONE(i)
+#define OP_ADDU(i) RD (i) = RS (i) + RT (i);
+#define OP_AND(i) RD (i) = RS (i) & RT (i);
+#define OP_OR(i) RD (i) = RS (i) | RT (i);
+#define OP_SUBU(i) RD (i) = RS (i) - RT (i);
+#define OP_SLT(i) RD (i) = 0;
+#define OP_SLL(i) RD (i) = RS (i) << RT (i);
+#define OP_SRL(i) RD (i) = RS (i) >> RT (i);
+#define OP_ADDIU(i) RT (i) = RT (i) + StagedImmed (IMMED (i));
+#define OP_ANDI(i) RT (i) = RT (i) & StagedImmed (IMMED (i));
+#define OP_ORI(i) RT (i) = RS (i) | StagedImmed (IMMED (i));
+#define OP_LUI(i) RT (i) = StagedImmed (IMMED (i)) << 16;
+#define OP_LW(i) RT (i) = Load (memory, INDEX (RS (i) + IMMED (i)));
+#define OP_SW(i) { \
+        int addr = RS (i) + IMMED (i); \
+        if (INIMAGE (addr)) { \
+            Store (memory, img, INDEX (addr), RT (i)); \
+        } \
+    }
+#define OP_BEQ(i) if (RS (i) == RT (i)) next = h->pc + 4*(i) + 4 + (IMMED (i) << 2);
+#define OP_BNE(i) if (RS (i) != RT (i)) next = h->pc + 4*(i) + 8 + (IMMED (i) << 2);
+#define OP_J(i) next = img->target[k+(i)];
+#define OP_JR(i) next = r[31];
+
+#define SUPERHANDLER(n, length, a, b, c) \
+static void Super##n (Hart *h, int *memory, DecodedImage *img, int k) { \
+    int *r = h->registers; \
+    int next = h->pc + 4*(length); \
+    OP_##a (0) OP_##b (1) OP_##c (2) \
+    h->pc = next; \
+    h->instrCount += length; \
+}
+SUPEROPS (SUPERHANDLER)
+
+#define SUPERENTRY(n, length, a, b, c) { length, Super##n },
+
+static const struct {
+    int length;
+    void (*handler) (Hart *h, int *memory, DecodedImage *img, int k);
+} superOps[NUMSUPEROPS+1] = {
+    SUPEROPS (SUPERENTRY)
+};
+
+/*
+ *  Run the superinstruction the image marks at h->pc, if there is one
+ *  and it is no longer than max.  Return how many instructions it ran,
+ *  0 for none.  Like StepHart it calls no plugin.
+ */
+int StepSuper (Hart *h, int *memory, DecodedImage *img, long max) {
+    int k = INDEX (h->pc), n;
+
+    if (!INRANGE (k) || img->super[k] == 0) {
+        return 0;
+    }
+    n = img->super[k] - 1;
+    if (superOps[n].length > max) {
+        return 0;
+    }
+    superOps[n].handler (h, memory, img, k);
+    return superOps[n].length;
+}
+
+/* Copy a machine's registers and pc into a hart, and back. */
+void LoadHart (Hart *h, Computer *c) {
+    memcpy (h->registers, c->registers, sizeof (h->registers));
+    h->pc = c->pc;
+    h->instrCount = c->instrCount;
+    h->bigEndian = c->bigEndian;
+    h->link = -1;
+    h->in = NULL;
+    h->out = NULL;
+}
+
+void StoreHart (Hart *h, Computer *c) {
+    memcpy (c->registers, h->registers, sizeof (h->registers));
+    c->pc = h->pc;
+    c->instrCount = h->instrCount;
+    c->bigEndian = h->bigEndian;
+}
@@ -0,0 +1,30 @@
+
+/*
+ *  Functional engine.  Executes straight from the bulk-decoded image
+ *  instead of going through Decode/Execute/UpdatePC/Mem/RegWrite, with
+ *  the same results as that staged pipeline.  The architectural state
+ *  is a Hart so several of them can share one memory.
+ */
+
+typedef struct {
+    int registers [32];
+    int pc;
+    long instrCount;	/* instructions simulated so far */
+    int link;		/* memory index reserved by ll, otherwise -1 */
+    int linkVal;	/* value ll read there */
+    int bigEndian;	/* as in Computer */
+    FILE *in, *out;	/* where syscalls read and print, NULL for stdio */
+} Hart;
+
+extern int fusing;	/* whether MipsStep runs superinstructions */
+
+typedef int (*StepFn) (Hart *h, int *memory, DecodedImage *img,
+    int *changedReg, int *changedMem);
+
+int StepHart (Hart *h, int *memory, DecodedImage *img,
+    int *changedReg, int *changedMem);
+StepFn SelectStep (void);
+int StepSuper (Hart *h, int *memory, DecodedImage *img, long max);
+ExitReason StopReason (DecodedImage *img, int pc);
+void LoadHart (Hart *h, Computer *c);
+void StoreHart (Hart *h, Computer *c);
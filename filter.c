@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+#include "elf.h"
+
+TraceFilter traceFilter;
+int filtering = 0;	/* any filter set */
+int silent = 0;
+
+void InitTraceFilter () {
+    memset (&traceFilter, 0, sizeof (traceFilter));
+    traceFilter.startPc = -1;
+    traceFilter.stopPc = -1;
+    traceFilter.active = 1;
+}
+
+/*
+ *  Set the filter for a command-line option from its value.  Return 0 if
+ *  option is not a trace filter, 1 if it is; exit on a malformed value.
+ */
+int SetTraceFilter (char *option, char *value) {
+    TraceFilter *f = &traceFilter;
+    int n;
+
+    if (strcmp (option, "--trace-pc") == 0) {
+        /* LO:HI, each a symbol or hex */
+        char lo[64], hi[64];
+        n = sscanf (value, "%63[^:]:%63s", lo, hi) == 2
+            ? ParseAddress (lo, &f->pcLo) + ParseAddress (hi, &f->pcHi) : 0;
+        f->pcRange = 1;
+    } else if (strcmp (option, "--trace-window") == 0) {
+        n = sscanf (value, "%ld:%ld", &f->first, &f->last);
+    } else if (strcmp (option, "--trace-every") == 0) {
+        n = 2 * sscanf (value, "%ld", &f->every);
+    } else if (strcmp (option, "--trace-start") == 0) {
+        n = 2 * ParseAddress (value, (unsigned int *) &f->startPc);
+        f->active = 0;
+    } else if (strcmp (option, "--trace-stop") == 0) {
+        n = 2 * ParseAddress (value, (unsigned int *) &f->stopPc);
+    } else {
+        return 0;
+    }
+    if (n != 2) {
+        fprintf (stderr, "Bad value \"%s\" for %s.\n", value, option);
+        exit (1);
+    }
+    filtering = 1;
+    return 1;
+}
+
+/* Should the instruction at pc, the instrNumber'th simulated, be traced? */
+int TraceWanted (int pc, long instrNumber) {
+    TraceFilter *f = &traceFilter;
+    int wanted;
+
+    if (pc == f->startPc) {
+        f->active = 1;
+    }
+    wanted = f->active;
+    if (pc == f->stopPc) {
+        f->active = 0;
+    }
+    if (f->pcRange && ((unsigned int) pc < f->pcLo || (unsigned int) pc > f->pcHi)) {
+        return 0;
+    }
+    if (f->last && (instrNumber < f->first || instrNumber > f->last)) {
+        return 0;
+    }
+    if (f->every && instrNumber % f->every != 0) {
+        return 0;
+    }
+    return wanted;
+}
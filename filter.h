@@ -0,0 +1,29 @@
+
+/*
+ *  Trace filters.  Decide, before anything is formatted, whether the
+ *  instruction about to be simulated should appear in the trace.  Every
+ *  filter that has been set must agree:
+ *    - the pc is within [pcLo, pcHi]
+ *    - the instruction's number (counting from 1) is within [first, last]
+ *    - the instruction number is a multiple of every
+ *    - tracing has been switched on by reaching the start pc and not yet
+ *      switched off again by the stop pc (both included in the trace)
+ *  Addresses may be given as symbols of a loaded ELF executable.
+ */
+
+typedef struct {
+    int pcRange;
+    unsigned int pcLo, pcHi;
+    long first, last;	/* last is 0 if unset */
+    long every;		/* 0 if unset */
+    int startPc, stopPc;	/* -1 if unset */
+    int active;		/* between the start and stop pcs */
+} TraceFilter;
+
+extern TraceFilter traceFilter;
+extern int filtering;
+extern int silent;	/* trace nothing at all */
+
+void InitTraceFilter ();
+int SetTraceFilter (char *option, char *value);
+int TraceWanted (int pc, long instrNumber);
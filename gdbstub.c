@@ -0,0 +1,521 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "computer.h"
+#include "decode.h"
+#include "mipssim.h"
+#include "gdbstub.h"
+
+#define BREAKWORD 0x0000000d	/* break, which the engine does not support */
+#define NUMGDBREGS 38		/* $0-$31, sr, lo, hi, badvaddr, cause, pc */
+#define PCREG 37
+
+#define SIGINT_ 2		/* signal numbers as gdb knows them */
+#define SIGILL_ 4
+#define SIGTRAP_ 5
+#define SIGSEGV_ 11
+
+/* A breakpoint (type 0 software, 1 hardware) or write watchpoint (2) */
+typedef struct {
+    int type, addr, length;
+    int saved;		/* the word a breakpoint replaced */
+} Point;
+
+static MipsSim *machine;
+static int conn;
+static unsigned char inBuf [GDBPACKET];
+static int inUsed, inNext;
+static Point points [MAXGDBBREAKS];
+static int numPoints;
+static int watchHit;		/* address of the store a watchpoint caught, or -1 */
+
+/* The next byte from the debugger, or -1 when it has gone. */
+static int GetByte () {
+    int n;
+
+    if (inNext == inUsed) {
+        n = read (conn, inBuf, sizeof (inBuf));
+        if (n <= 0) {
+            return -1;
+        }
+        inUsed = n;
+        inNext = 0;
+    }
+    return inBuf[inNext++];
+}
+
+static int HexDigit (int c) {
+    return isdigit (c) ? c - '0' : tolower (c) - 'a' + 10;
+}
+
+/*
+ *  Read a packet's contents into buf, acknowledging it.  Return its
+ *  length, or -1 when the debugger has gone.
+ */
+static int GetPacket (char *buf) {
+    int c, n, sum, check;
+
+    while (1) {
+        while ((c = GetByte ()) != '$') {
+            if (c == -1) {
+                return -1;
+            }
+        }
+        for (n=0, sum=0; (c = GetByte ()) != '#' && n < GDBPACKET-1; n++) {
+            if (c == -1) {
+                return -1;
+            }
+            buf[n] = c;
+            sum += c;
+        }
+        buf[n] = '\0';
+        c = GetByte ();
+        check = GetByte ();
+        if (c == -1 || check == -1) {
+            return -1;
+        }
+        if (((HexDigit (c) << 4) | HexDigit (check)) == (sum & 0xff)) {
+            write (conn, "+", 1);
+            return n;
+        }
+        write (conn, "-", 1);
+    }
+}
+
+/* Send a packet until the debugger acknowledges it. */
+static void PutPacket (const char *s) {
+    char frame [GDBPACKET+4];
+    int n = strlen (s), sum = 0, k, c;
+
+    for (k=0; k<n; k++) {
+        sum += (unsigned char) s[k];
+    }
+    sprintf (frame, "$%s#%2.2x", s, sum & 0xff);
+    do {
+        if (write (conn, frame, n+4) != n+4) {
+            return;
+        }
+        while ((c = GetByte ()) != '+' && c != '-' && c != -1) {
+        }
+    } while (c == '-');
+}
+
+/* Eight hex digits for a word, its bytes in the program's order */
+static void PutWord (char *p, unsigned int w) {
+    int k;
+
+    for (k=0; k<4; k++) {
+        sprintf (p + 2*k, "%2.2x",
+            (w >> BYTESHIFT (k, MipsBigEndian (machine))) & 0xff);
+    }
+}
+
+static unsigned int GetWord (const char *p) {
+    unsigned int w = 0;
+    int k;
+
+    for (k=0; k<4; k++) {
+        w |= (unsigned int) ((HexDigit (p[2*k]) << 4) | HexDigit (p[2*k+1]))
+            << BYTESHIFT (k, MipsBigEndian (machine));
+    }
+    return w;
+}
+
+/* The breakpoint planted at addr, or -1 */
+static int BreakAt (int addr) {
+    int k;
+
+    for (k=0; k<numPoints; k++) {
+        if (points[k].type < 2 && points[k].addr == addr) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+/* Read a word as the program wrote it, under any breakpoint. */
+static int ReadWord (int addr, int *value) {
+    int k = BreakAt (addr);
+
+    if (k != -1) {
+        *value = points[k].saved;
+        return 0;
+    }
+    return MipsReadMem (machine, addr, value);
+}
+
+static int WriteWord (int addr, int value) {
+    int k = BreakAt (addr);
+
+    if (k != -1) {
+        points[k].saved = value;
+        return 0;
+    }
+    return MipsWriteMem (machine, addr, value);
+}
+
+/* Step hook while watchpoints are set: stop on a store into one. */
+static int Watch (MipsSim *m, int pc, int changedReg, int changedMem,
+    void *arg) {
+    int k;
+
+    for (k=0; k<numPoints && changedMem != -1; k++) {
+        if (points[k].type == 2 && changedMem < points[k].addr + points[k].length
+            && points[k].addr < changedMem + 4) {
+            watchHit = changedMem;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void WatchIfNeeded () {
+    int k;
+
+    for (k=0; k<numPoints && points[k].type != 2; k++) {
+    }
+    MipsSetStepHook (machine, k < numPoints ? Watch : NULL, NULL);
+}
+
+/* Handle Z and z.  Reply with what gdb expects. */
+static void SetPoint (char *packet, char *reply) {
+    int type, addr, length, k;
+
+    if (sscanf (packet + 1, "%d,%x,%x", &type, &addr, &length) != 3 || type > 2) {
+        strcpy (reply, "");
+        return;
+    }
+    for (k=0; k<numPoints && (points[k].type != type || points[k].addr != addr); k++) {
+    }
+    if (packet[0] == 'z') {
+        if (k == numPoints) {
+            strcpy (reply, "OK");
+            return;
+        }
+        points[k] = points[--numPoints];
+        /* a software and a hardware breakpoint may share the word */
+        if (type < 2 && BreakAt (addr) == -1) {
+            MipsWriteMem (machine, addr, points[numPoints].saved);
+        }
+        WatchIfNeeded ();
+        strcpy (reply, "OK");
+        return;
+    }
+    if (k < numPoints) {
+        strcpy (reply, "OK");
+        return;
+    }
+    if (numPoints == MAXGDBBREAKS) {
+        strcpy (reply, "E01");
+        return;
+    }
+    points[k].type = type;
+    points[k].addr = addr;
+    points[k].length = length;
+    if (type < 2) {
+        if ((addr & 3) != 0 || ReadWord (addr, &points[k].saved) != 0) {
+            strcpy (reply, "E02");
+            return;
+        }
+        MipsWriteMem (machine, addr, BREAKWORD);
+    }
+    numPoints++;
+    WatchIfNeeded ();
+    strcpy (reply, "OK");
+}
+
+/* Reply to m with the bytes asked for. */
+static void ReadMemory (char *packet, char *reply) {
+    int addr, length, k, word;
+
+    if (sscanf (packet + 1, "%x,%x", &addr, &length) != 2
+        || length < 0 || length > GDBPACKET/2 - 1) {
+        strcpy (reply, "E01");
+        return;
+    }
+    for (k=0; k<length; k++) {
+        if (ReadWord ((addr + k) & ~3, &word) != 0) {
+            strcpy (reply, "E02");
+            return;
+        }
+        sprintf (reply + 2*k, "%2.2x",
+            (word >> BYTESHIFT (addr + k, MipsBigEndian (machine))) & 0xff);
+    }
+    reply[2*length] = '\0';
+}
+
+static void WriteMemory (char *packet, char *reply) {
+    int addr, length, k, word, shift;
+    char *data = strchr (packet, ':');
+
+    if (data == NULL || sscanf (packet + 1, "%x,%x", &addr, &length) != 2
+        || strlen (data + 1) < 2*length) {
+        strcpy (reply, "E01");
+        return;
+    }
+    for (k=0; k<length; k++) {
+        shift = BYTESHIFT (addr + k, MipsBigEndian (machine));
+        if (ReadWord ((addr + k) & ~3, &word) != 0) {
+            strcpy (reply, "E02");
+            return;
+        }
+        word = (word & ~(0xff << shift))
+            | ((HexDigit (data[1+2*k]) << 4 | HexDigit (data[2+2*k])) << shift);
+        WriteWord ((addr + k) & ~3, word);
+    }
+    strcpy (reply, "OK");
+}
+
+static unsigned int GetReg (int n) {
+    if (n < 32) {
+        return MipsGetReg (machine, n);
+    }
+    return n == PCREG ? MipsGetPc (machine) : 0;
+}
+
+static void SetReg (int n, unsigned int value) {
+    if (n < 32) {
+        MipsSetReg (machine, n, value);
+    } else if (n == PCREG) {
+        MipsSetPc (machine, value);
+    }
+}
+
+/* The stop reply for a run that ended short of what was asked. */
+static void Stopped (char *reply) {
+    int pc = MipsGetPc (machine);
+
+    if (watchHit != -1) {
+        sprintf (reply, "T%2.2xwatch:%x;", SIGTRAP_, watchHit);
+        return;
+    }
+    switch (MipsExitReason (machine)) {
+    case EXIT_SYSCALL:
+        strcpy (reply, "W00");
+        break;
+    case EXIT_UNSUPPORTED:
+        sprintf (reply, "S%2.2x", BreakAt (pc) != -1 ? SIGTRAP_ : SIGILL_);
+        break;
+    case EXIT_PCRANGE:
+        sprintf (reply, "S%2.2x", SIGSEGV_);
+        break;
+    default:
+        sprintf (reply, "S%2.2x", SIGTRAP_);
+        break;
+    }
+}
+
+/* Return 1 if the debugger has sent ^C. */
+static int Interrupted () {
+    struct pollfd p = { conn, POLLIN, 0 };
+    int c;
+
+    while (inNext < inUsed || poll (&p, 1, 0) > 0) {
+        if ((c = GetByte ()) == 0x03) {
+            return 1;
+        } else if (c == -1) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ *  Step one instruction, or continue until something stops the machine,
+ *  and put the stop reply in reply.  A breakpoint under the pc is lifted
+ *  for the first instruction.
+ */
+static void Resume (int stepping, char *reply) {
+    int pc = MipsGetPc (machine), k = BreakAt (pc);
+    long done;
+
+    watchHit = -1;
+    if (k != -1) {
+        MipsWriteMem (machine, pc, points[k].saved);
+        done = MipsStep (machine, 1);
+        /* before planting it again, which lets a stopped machine run */
+        if (done == 0 || watchHit != -1) {
+            Stopped (reply);
+        }
+        MipsWriteMem (machine, pc, BREAKWORD);
+        if (done == 0 || watchHit != -1) {
+            return;
+        }
+        if (stepping) {
+            sprintf (reply, "S%2.2x", SIGTRAP_);
+            return;
+        }
+    }
+    while (1) {
+        if (stepping) {
+            if (MipsStep (machine, 1) < 1 || watchHit != -1) {
+                Stopped (reply);
+            } else {
+                sprintf (reply, "S%2.2x", SIGTRAP_);
+            }
+            return;
+        }
+        if (MipsStep (machine, GDBCHUNK) < GDBCHUNK || watchHit != -1) {
+            Stopped (reply);
+            return;
+        }
+        if (Interrupted ()) {
+            sprintf (reply, "S%2.2x", SIGINT_);
+            return;
+        }
+    }
+}
+
+/* Accept one debugger on a TCP port of localhost or a Unix socket. */
+static int Connect (char *where) {
+    struct sockaddr_in in;
+    struct sockaddr_un un;
+    int fd, c, one = 1;
+
+    if (strspn (where, "0123456789") == strlen (where)) {
+        fd = socket (AF_INET, SOCK_STREAM, 0);
+        memset (&in, 0, sizeof (in));
+        in.sin_family = AF_INET;
+        in.sin_port = htons (atoi (where));
+        in.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+        if (fd < 0 || bind (fd, (struct sockaddr *) &in, sizeof (in)) != 0
+            || listen (fd, 1) != 0) {
+            fprintf (stderr, "Can't listen for gdb on port %s.\n", where);
+            exit (1);
+        }
+    } else {
+        fd = socket (AF_UNIX, SOCK_STREAM, 0);
+        memset (&un, 0, sizeof (un));
+        un.sun_family = AF_UNIX;
+        if (fd < 0 || strlen (where) >= sizeof (un.sun_path)) {
+            fprintf (stderr, "Can't listen for gdb on %s.\n", where);
+            exit (1);
+        }
+        strcpy (un.sun_path, where);
+        unlink (where);
+        if (bind (fd, (struct sockaddr *) &un, sizeof (un)) != 0
+            || listen (fd, 1) != 0) {
+            fprintf (stderr, "Can't listen for gdb on %s.\n", where);
+            exit (1);
+        }
+    }
+    fprintf (stderr, "Waiting for gdb on %s.\n", where);
+    c = accept (fd, NULL, NULL);
+    close (fd);
+    if (c < 0) {
+        fprintf (stderr, "Can't accept gdb's connection.\n");
+        exit (1);
+    }
+    return c;
+}
+
+/* Serve one debugger session on m until it detaches, kills or hangs up. */
+void ServeGdb (MipsSim *m, char *where) {
+    static char packet [GDBPACKET], reply [GDBPACKET+4];
+    unsigned int addr;
+    int n, k;
+
+    machine = m;
+    numPoints = 0;
+    conn = Connect (where);
+    /* a debugger that goes away mid-reply ends the session, not sim */
+    signal (SIGPIPE, SIG_IGN);
+    inUsed = inNext = 0;
+    sprintf (reply, "S%2.2x", SIGTRAP_);
+
+    while (GetPacket (packet) >= 0) {
+        switch (packet[0]) {
+        case '?':
+            Stopped (reply);
+            if (MipsExitReason (machine) == EXIT_RUNNING) {
+                sprintf (reply, "S%2.2x", SIGTRAP_);
+            }
+            break;
+        case 'g':
+            for (k=0; k<NUMGDBREGS; k++) {
+                PutWord (reply + 8*k, GetReg (k));
+            }
+            break;
+        case 'G':
+            for (k=0; k<NUMGDBREGS && strlen (packet + 1) >= 8*(k+1); k++) {
+                SetReg (k, GetWord (packet + 1 + 8*k));
+            }
+            strcpy (reply, "OK");
+            break;
+        case 'p':
+            n = strtol (packet + 1, NULL, 16);
+            if (n < NUMGDBREGS) {
+                PutWord (reply, GetReg (n));
+            } else {
+                strcpy (reply, "xxxxxxxx");
+            }
+            break;
+        case 'P':
+            if (sscanf (packet + 1, "%x=", &n) == 1 && strchr (packet, '=') != NULL
+                && strlen (strchr (packet, '=') + 1) >= 8) {
+                SetReg (n, GetWord (strchr (packet, '=') + 1));
+                strcpy (reply, "OK");
+            } else {
+                strcpy (reply, "E01");
+            }
+            break;
+        case 'm':
+            ReadMemory (packet, reply);
+            break;
+        case 'M':
+            WriteMemory (packet, reply);
+            break;
+        case 'c':
+        case 's':
+            if (sscanf (packet + 1, "%x", &addr) == 1) {
+                MipsSetPc (machine, addr);
+            }
+            Resume (packet[0] == 's', reply);
+            break;
+        case 'Z':
+        case 'z':
+            SetPoint (packet, reply);
+            break;
+        case 'H':
+        case 'T':
+            strcpy (reply, "OK");
+            break;
+        case 'q':
+            if (strncmp (packet, "qSupported", 10) == 0) {
+                sprintf (reply, "PacketSize=%x", GDBPACKET);
+            } else if (strcmp (packet, "qAttached") == 0) {
+                strcpy (reply, "1");
+            } else if (strcmp (packet, "qC") == 0) {
+                strcpy (reply, "QC1");
+            } else if (strcmp (packet, "qfThreadInfo") == 0) {
+                strcpy (reply, "m1");
+            } else if (strcmp (packet, "qsThreadInfo") == 0) {
+                strcpy (reply, "l");
+            } else {
+                strcpy (reply, "");
+            }
+            break;
+        case 'D':
+            PutPacket ("OK");
+            close (conn);
+            return;
+        case 'k':
+            close (conn);
+            return;
+        default:
+            strcpy (reply, "");
+            break;
+        }
+        PutPacket (reply);
+    }
+    close (conn);
+}
@@ -0,0 +1,27 @@
+
+/*
+ *  GDB remote serial protocol stub.  sim --gdb PORT|PATH loads the
+ *  program and waits for one debugger on localhost:PORT, or on the Unix
+ *  socket PATH, then runs the machine on the functional engine as the
+ *  debugger asks.  The target is little-endian 32-bit MIPS:
+ *
+ *      gdb-multiarch -ex 'set architecture mips' -ex 'set endian little'
+ *          -ex 'target remote :1234'
+ *
+ *  Supported: registers (the 32 general ones and pc; sr, lo, hi, badvaddr
+ *  and cause read as 0) and memory read and write, step and continue
+ *  (^C interrupts), software and hardware breakpoints, and write
+ *  watchpoints.  Breakpoints are the MIPS break instruction planted in
+ *  memory, which the engine refuses like any unsupported instruction, so
+ *  a continue runs at full speed; reads show the original words.  Write
+ *  watchpoints need a look at every store, so they slow the run while
+ *  any is set.  A program that ends with the exit syscall is reported as
+ *  exited; one that stops otherwise (unsupported instruction, pc out of
+ *  range, branch to itself) as a signal, so its state can still be seen.
+ */
+
+#define MAXGDBBREAKS 64		/* breakpoints and watchpoints at once */
+#define GDBPACKET 4096		/* largest packet, in characters */
+#define GDBCHUNK 65536		/* instructions between checks for ^C */
+
+void ServeGdb (MipsSim *m, char *where);
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "computer.h"
+#include "decode.h"
+#include "engine.h"
+#include "metrics.h"
+#include "harts.h"
+#undef mips			/* gcc already has a def for mips */
+
+extern Computer mips;
+extern DecodedImage image;
+
+typedef struct {
+    Hart hart;
+    DecodedImage *image;	/* its own, as stores redecode it */
+    int id;
+    int halted;
+    ExitReason exitReason;
+    LoopState loop;
+    pthread_t thread;
+} HartThread;
+
+static HartThread *harts;
+static int numHarts;
+static int parallel;
+static long quantum;
+
+/* Whose turn it is in round-robin mode */
+static pthread_mutex_t turnLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t turnChanged = PTHREAD_COND_INITIALIZER;
+static int turn = 0;
+
+/* Hand the turn to the next hart after t that has not halted. */
+static void PassTurn (HartThread *t) {
+    int k;
+
+    pthread_mutex_lock (&turnLock);
+    for (k=1; k<=numHarts; k++) {
+        int next = (t->id + k) % numHarts;
+        if (!harts[next].halted) {
+            turn = next;
+            break;
+        }
+    }
+    pthread_cond_broadcast (&turnChanged);
+    pthread_mutex_unlock (&turnLock);
+}
+
+static void *RunHart (void *arg) {
+    HartThread *t = arg;
+    int changedReg, changedMem, pc;
+    StepFn step = SelectStep ();
+    long k;
+
+    while (!t->halted) {
+        if (!parallel) {
+            pthread_mutex_lock (&turnLock);
+            while (turn != t->id) {
+                pthread_cond_wait (&turnChanged, &turnLock);
+            }
+            pthread_mutex_unlock (&turnLock);
+        }
+        for (k=0; parallel || k<quantum; k++) {
+            pc = t->hart.pc;
+            if (!step (&t->hart, mips.memory, t->image,
+                       &changedReg, &changedMem)) {
+                t->exitReason = StopReason (t->image, pc);
+                t->halted = 1;
+                break;
+            }
+            /* --max-instr is for each hart */
+            t->exitReason = CheckLimits (t->hart.instrCount, mips.maxInstr, pc,
+                t->hart.pc, changedReg, changedMem, t->hart.registers, &t->loop);
+            if (t->exitReason != EXIT_RUNNING) {
+                t->halted = 1;
+                break;
+            }
+        }
+        if (!parallel) {
+            PassTurn (t);
+        }
+    }
+    return NULL;
+}
+
+static void PrintHart (HartThread *t) {
+    int k;
+
+    printf ("Hart %d: %ld instructions, pc = %8.8x, %s\n",
+        t->id, t->hart.instrCount, t->hart.pc, exitReasonNames[t->exitReason]);
+    if (mips.printingRegisters) {
+        for (k=0; k<32; k++) {
+            printf ("r%2.2d: %8.8x  ", k, t->hart.registers[k]);
+            if ((k+1)%4 == 0) {
+                printf ("\n");
+            }
+        }
+    }
+}
+
+/*
+ *  Run the loaded program on numHarts harts until they all stop.  Hart k
+ *  starts at the beginning of the code with $k0 = k, $k1 = numHarts and
+ *  its own stack below those of the harts before it.  In round-robin mode
+ *  each hart runs quantum instructions per turn.  A hart stops where
+ *  Simulate would, --max-instr counting its own instructions.  Each hart
+ *  steps from its own copy of the decoded image, which its stores keep
+ *  up to date, so no thread writes what another reads.
+ */
+void RunHarts (int n, int inParallel, long instrsPerTurn) {
+    int k, addr;
+
+    numHarts = n;
+    parallel = inParallel;
+    quantum = instrsPerTurn;
+    harts = calloc (numHarts, sizeof (HartThread));
+    if (harts == NULL) {
+        fprintf (stderr, "Out of memory for harts.\n");
+        exit (1);
+    }
+    for (k=0; k<numHarts; k++) {
+        LoadHart (&harts[k].hart, &mips);
+        harts[k].id = k;
+        harts[k].hart.registers[26] = k;
+        harts[k].hart.registers[27] = numHarts;
+        harts[k].hart.registers[29] -= k * HARTSTACK;
+        harts[k].loop.pc = -1;
+        harts[k].image = malloc (sizeof (DecodedImage));
+        if (harts[k].image == NULL) {
+            fprintf (stderr, "Out of memory for harts.\n");
+            exit (1);
+        }
+        memcpy (harts[k].image, &image, sizeof (DecodedImage));
+    }
+    fflush (stdout);
+    for (k=0; k<numHarts; k++) {
+        if (pthread_create (&harts[k].thread, NULL, RunHart, &harts[k]) != 0) {
+            fprintf (stderr, "Can't start hart %d.\n", k);
+            exit (1);
+        }
+    }
+    for (k=0; k<numHarts; k++) {
+        pthread_join (harts[k].thread, NULL);
+    }
+
+    /* the run ends as the first hart that stopped abnormally, or hart 0 */
+    mips.instrCount = 0;
+    mips.exitReason = harts[0].exitReason;
+    mips.pc = harts[0].hart.pc;
+    for (k=0; k<numHarts; k++) {
+        PrintHart (&harts[k]);
+        mips.instrCount += harts[k].hart.instrCount;
+        if (exitStatus[mips.exitReason] == 0 && exitStatus[harts[k].exitReason] != 0) {
+            mips.exitReason = harts[k].exitReason;
+            mips.pc = harts[k].hart.pc;
+        }
+    }
+    if (mips.printingMemory) {
+        printf ("Nonzero memory\n");
+        printf ("ADDR	  CONTENTS\n");
+        for (addr = 0x00400000+4*MAXNUMINSTRS;
+             addr < 0x00400000+4*(MAXNUMINSTRS+MAXNUMDATA);
+             addr = addr+4) {
+            if (mips.memory[(addr-0x00400000)/4] != 0) {
+                printf ("%8.8x  %8.8x\n", addr, mips.memory[(addr-0x00400000)/4]);
+            }
+        }
+    }
+    for (k=0; k<numHarts; k++) {
+        free (harts[k].image);
+    }
+    free (harts);
+}
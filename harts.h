@@ -0,0 +1,12 @@
+
+/*
+ *  Several harts, each with its own registers and pc, sharing the memory
+ *  of the loaded program.  Every hart runs on its own host thread, either
+ *  taking turns in a fixed order (deterministic) or all at once.  Like
+ *  instruction caches kept apart, a hart sees code another hart stores
+ *  only in memory, not in what it executes.
+ */
+
+#define HARTSTACK 1024		/* bytes of stack given to each hart */
+
+void RunHarts (int numHarts, int parallel, long quantum);
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "hostperf.h"
+
+#define NUMHOSTEVENTS 7
+
+#define CACHE(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    const char *name;
+    int type;
+    long config;
+} events[NUMHOSTEVENTS] = {
+    { "task-clock ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "L1d read misses", PERF_TYPE_HW_CACHE, CACHE (PERF_COUNT_HW_CACHE_L1D) },
+    { "L1i read misses", PERF_TYPE_HW_CACHE, CACHE (PERF_COUNT_HW_CACHE_L1I) },
+    { "LLC read misses", PERF_TYPE_HW_CACHE, CACHE (PERF_COUNT_HW_CACHE_LL) },
+};
+
+static int fds[NUMHOSTEVENTS];
+static int started = 0, opened = 0;
+static int lastErrno;		/* why the last counter could not be opened */
+
+void StartHostCounters () {
+    struct perf_event_attr attr;
+    int k;
+
+    /* a second run starts from nothing, none of the last run's counters */
+    opened = 0;
+    for (k=0; k<NUMHOSTEVENTS; k++) {
+        fds[k] = -1;
+    }
+    for (k=0; k<NUMHOSTEVENTS; k++) {
+        memset (&attr, 0, sizeof (attr));
+        attr.size = sizeof (attr);
+        attr.type = events[k].type;
+        attr.config = events[k].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds[k] = syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds[k] < 0) {
+            lastErrno = errno;
+        } else {
+            opened++;
+        }
+    }
+    started = 1;
+    for (k=0; k<NUMHOSTEVENTS; k++) {
+        if (fds[k] >= 0) {
+            ioctl (fds[k], PERF_EVENT_IOC_RESET, 0);
+            ioctl (fds[k], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/*
+ *  Stop the counters and report them on stderr for the run of instrs
+ *  simulated instructions (0 if the engine does not say) by engine.
+ */
+void ReportHostCounters (const char *engine, long instrs) {
+    unsigned long values[NUMHOSTEVENTS][3];	/* count, enabled, running */
+    double count;
+    int k, n;
+
+    if (!started) {
+        return;
+    }
+    for (k=0; k<NUMHOSTEVENTS; k++) {
+        if (fds[k] >= 0) {
+            ioctl (fds[k], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    started = 0;
+    fprintf (stderr, "Host counters, %s", engine);
+    if (instrs > 0) {
+        fprintf (stderr, ", %ld simulated instructions", instrs);
+    }
+    fprintf (stderr, ":\n");
+    if (opened == 0) {
+        fprintf (stderr, "  not available (%s)%s\n", strerror (lastErrno),
+            lastErrno == EACCES || lastErrno == EPERM
+            ? "; see /proc/sys/kernel/perf_event_paranoid" : "");
+        return;
+    }
+    for (k=0; k<NUMHOSTEVENTS; k++) {
+        if (fds[k] < 0) {
+            fprintf (stderr, "  %-16s %15s\n", events[k].name, "not available");
+            continue;
+        }
+        n = read (fds[k], values[k], sizeof (values[k]));
+        close (fds[k]);
+        if (n != sizeof (values[k])) {
+            fprintf (stderr, "  %-16s %15s\n", events[k].name, "not available");
+            continue;
+        }
+        count = values[k][0];
+        if (values[k][2] > 0 && values[k][2] < values[k][1]) {
+            count = count * values[k][1] / values[k][2];
+        }
+        fprintf (stderr, "  %-16s %15.0f", events[k].name, count);
+        if (instrs > 0) {
+            fprintf (stderr, "  %10.3f per instruction", count / instrs);
+        }
+        if (values[k][2] < values[k][1]) {
+            fprintf (stderr, "  (counted %.0f%% of the time)",
+                values[k][2] > 0 ? 100.0 * values[k][2] / values[k][1] : 0.0);
+        }
+        fprintf (stderr, "\n");
+    }
+}
@@ -0,0 +1,14 @@
+
+/*
+ *  Host hardware counters around a run, from Linux perf_event_open:
+ *  cycles, instructions, branch misses and L1 and last-level cache
+ *  misses of the simulator process itself (user mode only), with the
+ *  task clock as a software baseline that works without a PMU, reported
+ *  in total and per simulated instruction along with the engine mode
+ *  that ran.  Counters the host or its settings refuse are left out,
+ *  and with none at all the report says why instead.  Counts the kernel
+ *  multiplexed are scaled up to the whole run.
+ */
+
+void StartHostCounters ();
+void ReportHostCounters (const char *engine, long instrs);
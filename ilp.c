@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "computer.h"
+#include "decode.h"
+#include "mipssim.h"
+#include "ilp.h"
+
+#define INDEX(addr) (((addr) - 0x00400000) / 4)
+#define INRANGE(k) ((k) >= 0 && (k) < IMAGEWORDS)
+#define MEMORY 32		/* stands for memory where a register number goes */
+
+/* Ready times under one window size; window 0 is unbounded */
+typedef struct {
+    int window;
+    long regs [32];
+    long *mem;		/* for each memory word */
+    long *retire;	/* when each of the last window instructions retired */
+    long lastRetire;
+    long cycles;	/* the last completion so far */
+} Schedule;
+
+/* A static dependence: to read loc (a register, or MEMORY) written by from */
+typedef struct {
+    int from, to, loc;
+    long count;		/* times it was the latest input of to */
+} Edge;
+
+/* What the instruction just simulated changed, from the step hook */
+typedef struct {
+    int reg, mem;
+} Changed;
+
+static Edge edges [ILPEDGES];
+static int regPc [32], *memPc;	/* last writer of each location, or -1 */
+
+static int Record (MipsSim *m, int pc, int changedReg, int changedMem,
+    void *arg) {
+    Changed *c = arg;
+
+    c->reg = changedReg;
+    c->mem = changedMem;
+    return 0;
+}
+
+/*
+ *  The registers the instruction reads, in src[], and the memory index
+ *  it loads from (-1 if none).  Return how many registers.  These follow
+ *  the staged pipeline: addiu and andi read rt, shifts read rt for the
+ *  amount, jr reads $31 and slt reads nothing.
+ */
+static int Sources (MipsSim *m, int instr, int *src, int *load) {
+    int op = (instr >> 26) & 0x3f, rs = (instr >> 21) & 0x1f;
+    int rt = (instr >> 16) & 0x1f;
+
+    *load = -1;
+    switch (KindOf (op, instr & 0x3f)) {
+    case K_ADDU: case K_AND: case K_OR: case K_SUBU: case K_SLL: case K_SRL:
+    case K_BEQ: case K_BNE: case K_SW:
+        src[0] = rs;
+        src[1] = rt;
+        return 2;
+    case K_SC:
+        src[0] = rs;
+        src[1] = rt;
+        *load = INDEX (MipsGetReg (m, rs) + (short) instr);
+        return 2;
+    case K_LW: case K_LL:
+        src[0] = rs;
+        *load = INDEX (MipsGetReg (m, rs) + (short) instr);
+        return 1;
+    case K_ADDIU: case K_ANDI:
+        src[0] = rt;
+        return 1;
+    case K_ORI:
+        src[0] = rs;
+        return 1;
+    case K_JR:
+        src[0] = 31;
+        return 1;
+    case K_SYSCALL:
+        src[0] = 2;
+        src[1] = 4;
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static void Charge (int from, int to, int loc) {
+    unsigned int h = ((unsigned int) from * 31 + to) * 37 + loc, k;
+
+    for (k=0; k<ILPEDGES; k++) {
+        Edge *e = &edges[(h + k) % ILPEDGES];
+        if (e->count == 0) {
+            e->from = from;
+            e->to = to;
+            e->loc = loc;
+        }
+        if (e->from == from && e->to == to && e->loc == loc) {
+            e->count++;
+            return;
+        }
+    }
+}
+
+/*
+ *  Place the instruction at pc in schedule s as the nth of the run.
+ *  For the unbounded schedule, charge the dependence it waited on.
+ */
+static void Place (Schedule *s, long n, int pc, int *src, int numSrc, int load,
+    Changed *c) {
+    long ready = 0, done;
+    int k, slot, from = -1, loc = -1;
+
+    for (k=0; k<numSrc; k++) {
+        if (s->regs[src[k]] > ready) {
+            ready = s->regs[src[k]];
+            from = regPc[src[k]];
+            loc = src[k];
+        }
+    }
+    if (INRANGE (load) && s->mem[load] > ready) {
+        ready = s->mem[load];
+        from = memPc[load];
+        loc = MEMORY;
+    }
+    if (s->window == 0 && from != -1) {
+        Charge (from, pc, loc);
+    }
+    if (s->window > 0) {
+        /* it can't enter the window before the one window back retires */
+        slot = n % s->window;
+        ready = s->retire[slot] > ready ? s->retire[slot] : ready;
+    }
+    done = ready + 1;
+    if (s->window > 0) {
+        s->lastRetire = done > s->lastRetire ? done : s->lastRetire;
+        s->retire[slot] = s->lastRetire;
+    }
+    if (c->reg != -1) {
+        s->regs[c->reg] = done;
+    }
+    if (c->mem != -1 && INRANGE (INDEX (c->mem))) {
+        s->mem[INDEX (c->mem)] = done;
+    }
+    s->cycles = done > s->cycles ? done : s->cycles;
+}
+
+static int CompareEdges (const void *a, const void *b) {
+    const Edge *x = a, *y = b;
+    return (y->count > x->count) - (y->count < x->count);
+}
+
+static void PrintLoc (int loc) {
+    if (loc == MEMORY) {
+        printf ("mem");
+    } else {
+        printf ("$%d", loc);
+    }
+}
+
+/* Follow the hottest dependence out of each instruction from the hottest. */
+static void PrintChain (int numEdges) {
+    int k = 0, link, pc, seen [CHAINLENGTH+1];
+
+    printf ("  hottest chain: %8.8x", edges[0].from);
+    seen[0] = edges[0].from;
+    for (link=1; link<=CHAINLENGTH; link++) {
+        pc = edges[k].to;
+        printf (" -");
+        PrintLoc (edges[k].loc);
+        printf ("-> %8.8x", pc);
+        seen[link] = pc;
+        for (k=0; seen[k] != pc; k++) {
+        }
+        if (k < link) {
+            printf (" (loop)");
+            break;
+        }
+        /* edges are sorted, so the first out of pc is the hottest */
+        for (k=0; k<numEdges && edges[k].from != pc; k++) {
+        }
+        if (k == numEdges) {
+            break;
+        }
+    }
+    printf ("\n");
+}
+
+/*
+ *  Run m to the end, or for maxInstr instructions unless that is 0,
+ *  scheduling every instruction without a window and under each of the
+ *  numWindows window sizes, and report.
+ */
+void AnalyzeIlp (MipsSim *m, int *windows, int numWindows, long maxInstr) {
+    Schedule s [MAXWINDOWS+1];
+    Changed c;
+    int numSchedules = numWindows + 1, src [3], numSrc, load, pc, instr, k;
+    int numEdges;
+    long n;
+
+    memPc = malloc (IMAGEWORDS * sizeof (int));
+    memset (s, 0, sizeof (s));
+    for (k=0; k<numSchedules; k++) {
+        s[k].window = k == 0 ? 0 : windows[k-1];
+        s[k].mem = calloc (IMAGEWORDS, sizeof (long));
+        s[k].retire = calloc (s[k].window > 0 ? s[k].window : 1, sizeof (long));
+        if (memPc == NULL || s[k].mem == NULL || s[k].retire == NULL) {
+            fprintf (stderr, "Out of memory for dependency analysis.\n");
+            exit (1);
+        }
+    }
+    for (k=0; k<32; k++) {
+        regPc[k] = -1;
+    }
+    for (k=0; k<IMAGEWORDS; k++) {
+        memPc[k] = -1;
+    }
+    memset (edges, 0, sizeof (edges));
+    MipsSetStepHook (m, Record, &c);
+
+    for (n=0; maxInstr == 0 || n < maxInstr; n++) {
+        pc = MipsGetPc (m);
+        if (MipsReadMem (m, pc, &instr) != 0) {
+            break;
+        }
+        numSrc = Sources (m, instr, src, &load);
+        c.reg = c.mem = -1;
+        if (MipsStep (m, 1) == 0) {
+            break;
+        }
+        for (k=0; k<numSchedules; k++) {
+            Place (&s[k], n, pc, src, numSrc, load, &c);
+        }
+        if (c.reg != -1) {
+            regPc[c.reg] = pc;
+        }
+        if (c.mem != -1 && INRANGE (INDEX (c.mem))) {
+            memPc[INDEX (c.mem)] = pc;
+        }
+        /* the step that finds a self loop counts, and is the last */
+        if (MipsExitReason (m) != EXIT_RUNNING) {
+            n++;
+            break;
+        }
+    }
+    MipsSetStepHook (m, NULL, NULL);
+
+    printf ("Dependency analysis: %ld instructions\n", n);
+    printf ("  critical path %ld cycles, ideal IPC %.3f\n", s[0].cycles,
+        s[0].cycles > 0 ? (double) n / s[0].cycles : 0.0);
+    for (k=1; k<numSchedules; k++) {
+        printf ("  window %4d: %ld cycles, IPC %.3f\n", s[k].window, s[k].cycles,
+            s[k].cycles > 0 ? (double) n / s[k].cycles : 0.0);
+    }
+
+    qsort (edges, ILPEDGES, sizeof (Edge), CompareEdges);
+    for (numEdges=0; numEdges<ILPEDGES && edges[numEdges].count>0; numEdges++) {
+    }
+    if (numEdges > 0) {
+        printf ("  hottest dependences (producer -> consumer, times last to arrive):\n");
+        for (k=0; k<numEdges && k<HOTEDGES; k++) {
+            printf ("    %8.8x -> %8.8x  ", edges[k].from, edges[k].to);
+            PrintLoc (edges[k].loc);
+            printf ("  %ld\n", edges[k].count);
+        }
+        PrintChain (numEdges);
+    }
+    for (k=0; k<numSchedules; k++) {
+        free (s[k].mem);
+        free (s[k].retire);
+    }
+    free (memPc);
+}
@@ -0,0 +1,20 @@
+
+/*
+ *  Dependency analysis.  Every instruction of a run is placed at the
+ *  earliest cycle its register and memory inputs allow, with a latency
+ *  of one cycle, perfect branch prediction and renaming (so only true
+ *  dependences count).  The last cycle is the critical path; the same
+ *  schedule with at most a window of instructions in flight gives the
+ *  IPC a machine of that size could reach.  Shadow state is one ready
+ *  time per register and memory word, whatever the length of the run.
+ *  Each instruction also charges the producer of its latest input, so
+ *  the static dependences that most often set the pace can be listed.
+ */
+
+#define MAXWINDOWS 8		/* window sizes analyzed at once */
+#define MAXWINDOW 4096		/* largest window */
+#define ILPEDGES 4096		/* static producer-consumer pairs counted */
+#define HOTEDGES 10		/* listed in the report */
+#define CHAINLENGTH 8		/* links followed from the hottest */
+
+void AnalyzeIlp (MipsSim *m, int *windows, int numWindows, long maxInstr);
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include "input.h"
+#include "tracebuf.h"
+
+static FILE *recording = NULL;
+static FILE *replaying = NULL;
+
+static FILE *OpenLog (char *path, char *mode) {
+    FILE *f = fopen (path, mode);
+    if (f == NULL) {
+        fprintf (stderr, "Can't open input log: %s\n", path);
+        exit (1);
+    }
+    return f;
+}
+
+void RecordInput (char *path) {
+    recording = OpenLog (path, "wb");
+    fwrite ("MIR1", 4, 1, recording);
+}
+
+void ReplayInput (char *path) {
+    char magic[4];
+
+    replaying = OpenLog (path, "rb");
+    if (fread (magic, 4, 1, replaying) != 1 || memcmp (magic, "MIR1", 4) != 0) {
+        fprintf (stderr, "Not an input log: %s\n", path);
+        exit (1);
+    }
+}
+
+/* Read the next line from the replay log; NULL once it is used up. */
+static char *ReplayLine (char *buf, int size) {
+    unsigned char len[2];
+    int n;
+
+    if (fread (len, 2, 1, replaying) != 1) {
+        return NULL;
+    }
+    n = len[0] | len[1] << 8;
+    if (n == INPUTEOF) {
+        return NULL;
+    }
+    if (n >= size || fread (buf, 1, n, replaying) != n) {
+        fprintf (stderr, "Corrupt input log.\n");
+        exit (1);
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+static void RecordLine (char *line) {
+    int n = line == NULL ? INPUTEOF : strlen (line);
+
+    fputc (n & 0xff, recording);
+    fputc (n >> 8, recording);
+    if (line != NULL) {
+        fwrite (line, 1, n, recording);
+    }
+    /* keep the log complete even if the run is killed */
+    fflush (recording);
+}
+
+/*
+ *  Read one line of input into buf, as fgets would from stdin.  Output
+ *  and trace still buffered are written first, so a prompt is seen
+ *  before the simulator waits.
+ */
+char *ReadInput (char *buf, int size) {
+    char *line;
+
+    if (replaying != NULL) {
+        line = ReplayLine (buf, size);
+    } else {
+        TraceFlush ();
+        line = fgets (buf, size, stdin);
+    }
+    if (recording != NULL) {
+        RecordLine (line);
+    }
+    return line;
+}
+
+/*
+ *  Whether ReadInput would return without waiting.  Only exact while
+ *  stdin is unbuffered, as a line stdio has already read ahead is not
+ *  seen.
+ */
+int InputReady (void) {
+    struct pollfd p = { 0, POLLIN, 0 };
+
+    return replaying != NULL || poll (&p, 1, 0) > 0;
+}
+
+/* Wait until ReadInput would return without waiting. */
+void WaitForInput (void) {
+    struct pollfd p = { 0, POLLIN, 0 };
+
+    if (replaying == NULL) {
+        poll (&p, 1, -1);
+    }
+}
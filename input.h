@@ -0,0 +1,19 @@
+
+/*
+ *  Every external input a run consumes -- interactive commands and
+ *  syscall 5 reads -- comes through ReadInput.  A run can record what it
+ *  read to a log, and a later run can replay the log instead of reading
+ *  the terminal, so the two runs see exactly the same input.
+ *
+ *  Log format: the 4 bytes "MIR1", then one record per ReadInput call:
+ *  a 2-byte little-endian length followed by that many bytes of the line
+ *  as read.  A length of 0xffff records end of input.
+ */
+
+#define INPUTEOF 0xffff
+
+void RecordInput (char *path);
+void ReplayInput (char *path);
+char *ReadInput (char *buf, int size);
+int InputReady (void);
+void WaitForInput (void);
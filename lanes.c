@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "computer.h"
+#include "decode.h"
+#include "engine.h"
+#include "metrics.h"
+#include "elf.h"
+#include "lanes.h"
+#undef mips			/* gcc already has a def for mips */
+
+#define INDEX(addr) (((addr) - 0x00400000) / 4)
+#define INRANGE(k) ((k) >= 0 && (k) < IMAGEWORDS)
+#define MAXLINE 4096
+
+extern Computer mips;
+
+typedef int LaneVec __attribute__ ((vector_size (LANES * sizeof (int))));
+
+typedef struct {
+    int memory [IMAGEWORDS];
+    Hart hart;		/* state once split off from the group */
+    DecodedImage *image;	/* decoded from memory once split off */
+    int line;		/* of the inputs file */
+    int exitReason;	/* EXIT_RUNNING until the instance stops */
+    LoopState loop;
+} Lane;
+
+typedef struct {
+    LaneVec r [32];
+    int pc;
+    unsigned int active;	/* lanes still in the group */
+    long instrCount;
+} Group;
+
+static const LaneVec zero;
+static Lane *lanes;
+static DecodedImage *shared;	/* the program as loaded, for the group */
+static long limit;
+static long laneInstrs, groupInstrs;	/* all instructions, and those run as vectors */
+
+/* Immediate as the staged pipeline uses it; see StagedImmed in engine.c. */
+static int StagedImmed (int immed) {
+    return (immed < 0 && immed != -1) ? immed + 1 : immed;
+}
+
+static int Load (int *memory, int k) {
+    return INRANGE (k) ? memory[k] : 0;
+}
+
+/*
+ *  Take lane l out of the group to carry on alone from pc, after count
+ *  instructions.
+ */
+static void Split (Group *g, int l, int pc, long count) {
+    Lane *lane = &lanes[l];
+    int k;
+
+    for (k=0; k<32; k++) {
+        lane->hart.registers[k] = g->r[k][l];
+    }
+    lane->hart.pc = pc;
+    lane->hart.instrCount = count;
+    lane->image = malloc (sizeof (DecodedImage));
+    if (lane->image == NULL) {
+        fprintf (stderr, "Out of memory for sweep lanes.\n");
+        exit (1);
+    }
+    DecodeImage (lane->memory, 0, IMAGEWORDS, 0x00400000, lane->image);
+    g->active &= ~(1u << l);
+}
+
+static void SplitAll (Group *g) {
+    int l;
+
+    for (l=0; l<LANES; l++) {
+        if (g->active & 1u << l) {
+            Split (g, l, g->pc, g->instrCount);
+        }
+    }
+}
+
+/*
+ *  Run the instruction at g->pc one lane at a time on the scalar engine,
+ *  for syscalls, ll and sc.  Lanes that stop leave the group.  Return 1
+ *  if one stored into the program.
+ */
+static int StepEachLane (Group *g) {
+    Hart h;
+    int l, k, changedReg, changedMem, stored = 0;
+
+    for (l=0; l<LANES; l++) {
+        if (!(g->active & 1u << l)) {
+            continue;
+        }
+        for (k=0; k<32; k++) {
+            h.registers[k] = g->r[k][l];
+        }
+        h.pc = g->pc;
+        h.instrCount = g->instrCount;
+        /* the lane's ll reservation lasts from one group step to the next */
+        h.link = lanes[l].hart.link;
+        h.linkVal = lanes[l].hart.linkVal;
+        h.in = NULL;
+        h.out = NULL;
+        if (!StepHart (&h, lanes[l].memory, shared, &changedReg, &changedMem)) {
+            lanes[l].hart = h;
+            lanes[l].exitReason = StopReason (shared, g->pc);
+            g->active &= ~(1u << l);
+            continue;
+        }
+        for (k=0; k<32; k++) {
+            g->r[k][l] = h.registers[k];
+        }
+        lanes[l].hart.link = h.link;
+        lanes[l].hart.linkVal = h.linkVal;
+        stored |= changedMem >= mips.textLo && changedMem < mips.textHi;
+    }
+    /* StepHart keeps the image in step with the lane it stored for */
+    if (stored) {
+        DecodeImage (mips.memory, 0, IMAGEWORDS, 0x00400000, shared);
+    }
+    return stored;
+}
+
+/*
+ *  The lanes of the group whose branch went the other way from most of
+ *  them leave it.  taken has bit l set if lane l's branch was taken.
+ *  Return whether the group's branch was.
+ */
+static int Diverge (Group *g, unsigned int taken, int takenPc, int notTakenPc) {
+    int l, count = 0, total = 0, goes;
+
+    for (l=0; l<LANES; l++) {
+        if (g->active & 1u << l) {
+            total++;
+            count += (taken >> l) & 1;
+        }
+    }
+    goes = 2*count >= total;
+    for (l=0; l<LANES; l++) {
+        if ((g->active & 1u << l) && ((taken >> l) & 1) != goes) {
+            Split (g, l, goes ? notTakenPc : takenPc, g->instrCount + 1);
+        }
+    }
+    return goes;
+}
+
+/* Run one instruction across the group.  Lanes leave it as they must. */
+static void StepGroup (Group *g) {
+    LaneVec *r = g->r;
+    int k = INDEX (g->pc);
+    int rs, rt, rd, immed, l, addr, next = g->pc + 4, stored = 0;
+    unsigned int taken;
+    LaneVec equal;
+
+    if (g->pc < mips.textLo || g->pc >= mips.textHi || !INRANGE (k)) {
+        SplitAll (g);
+        return;
+    }
+    rs = shared->rs[k];
+    rt = shared->rt[k];
+    rd = shared->rd[k];
+    immed = shared->immed[k];
+
+    switch (shared->op[k]) {
+    case 0x00:
+        switch (shared->funct[k]) {
+        case 0x21: r[rd] = r[rs] + r[rt]; break;
+        case 0x24: r[rd] = r[rs] & r[rt]; break;
+        case 0x25: r[rd] = r[rs] | r[rt]; break;
+        case 0x23: r[rd] = r[rs] - r[rt]; break;
+        /* the quirks of the staged pipeline, as in StepHart */
+        case 0x2a: r[rd] = zero; break;
+        case 0x00: r[rd] = r[rs] << r[rt]; break;
+        case 0x02: r[rd] = r[rs] >> r[rt]; break;
+        case 0x08:
+            /* follow the first lane; those going elsewhere leave */
+            for (l=0; !(g->active & 1u << l); l++) {
+            }
+            next = r[31][l];
+            for (l++; l<LANES; l++) {
+                if ((g->active & 1u << l) && r[31][l] != next) {
+                    Split (g, l, r[31][l], g->instrCount + 1);
+                }
+            }
+            break;
+        case 0x0c:
+            stored = StepEachLane (g);
+            break;
+        default:
+            SplitAll (g);
+            return;
+        }
+        break;
+    case 0x09: r[rt] = r[rt] + StagedImmed (immed); break;
+    case 0x0c: r[rt] = r[rt] & StagedImmed (immed); break;
+    case 0x0d: r[rt] = r[rs] | StagedImmed (immed); break;
+    case 0x0f: r[rt] = zero + (StagedImmed (immed) << 16); break;
+    case 0x04:
+    case 0x05:
+        equal = r[rs] == r[rt];
+        for (l=0, taken=0; l<LANES; l++) {
+            taken |= (equal[l] != 0) << l;
+        }
+        if (shared->op[k] == 0x05) {
+            taken = ~taken;
+        }
+        /* a taken bne lands one word past its target, as in StepHart */
+        addr = g->pc + (shared->op[k] == 0x05 ? 8 : 4) + (immed << 2);
+        if (Diverge (g, taken, addr, next)) {
+            next = addr;
+        }
+        break;
+    case 0x23:
+        for (l=0; l<LANES; l++) {
+            if (g->active & 1u << l) {
+                r[rt][l] = Load (lanes[l].memory, INDEX (r[rs][l] + immed));
+            }
+        }
+        break;
+    case 0x2b:
+        for (l=0; l<LANES; l++) {
+            addr = r[rs][l] + immed;
+            if ((g->active & 1u << l) && INIMAGE (addr)) {
+                lanes[l].memory[INDEX (addr)] = r[rt][l];
+                stored |= addr >= mips.textLo && addr < mips.textHi;
+            }
+        }
+        break;
+    case 0x30:
+    case 0x38:
+        stored = StepEachLane (g);
+        break;
+    case 0x02:
+        next = shared->target[k];
+        break;
+    case 0x03:
+        r[31] = zero + (g->pc + 4);
+        next = shared->target[k];
+        break;
+    default:
+        SplitAll (g);
+        return;
+    }
+    for (l=0; l<LANES; l++) {
+        groupInstrs += (g->active >> l) & 1;
+    }
+    g->pc = next;
+    g->instrCount++;
+    if (stored) {
+        /* the lanes' programs differ now */
+        SplitAll (g);
+    }
+}
+
+/* Run the first n lanes, already set up, until every one stops. */
+static void RunLanes (int n) {
+    Group g;
+    Lane *lane;
+    int l, k, pc, changedReg, changedMem;
+
+    memset (&g, 0, sizeof (g));
+    g.pc = mips.pc;
+    g.active = (1u << n) - 1;
+    for (l=0; l<n; l++) {
+        for (k=0; k<32; k++) {
+            g.r[k][l] = lanes[l].hart.registers[k];
+        }
+    }
+    DecodeImage (mips.memory, 0, IMAGEWORDS, 0x00400000, shared);
+    while (g.active != 0 && CheckLimits (g.instrCount, limit, -1, 0, -1, -1,
+            NULL, NULL) == EXIT_RUNNING) {
+        pc = g.pc;
+        StepGroup (&g);
+        if (g.pc == pc) {
+            /* branched to itself; the lanes see if it is for good */
+            SplitAll (&g);
+        }
+    }
+    for (l=0; l<n; l++) {
+        if (g.active & 1u << l) {
+            Split (&g, l, g.pc, g.instrCount);
+        }
+    }
+
+    for (l=0; l<n; l++) {
+        lane = &lanes[l];
+        if (lane->exitReason == EXIT_RUNNING) {
+            lane->exitReason = CheckLimits (lane->hart.instrCount, limit, -1, 0,
+                -1, -1, NULL, NULL);
+        }
+        while (lane->exitReason == EXIT_RUNNING) {
+            pc = lane->hart.pc;
+            if (!StepHart (&lane->hart, lane->memory, lane->image,
+                    &changedReg, &changedMem)) {
+                lane->exitReason = StopReason (lane->image, pc);
+            } else {
+                lane->exitReason = CheckLimits (lane->hart.instrCount, limit, pc,
+                    lane->hart.pc, changedReg, changedMem, lane->hart.registers,
+                    &lane->loop);
+            }
+        }
+        laneInstrs += lane->hart.instrCount;
+        free (lane->image);
+        lane->image = NULL;
+    }
+}
+
+/* Set lane l up from line, "$reg=value" and "addr=value" assignments. */
+static int ParseInstance (Lane *lane, char *line) {
+    char *word, *value, *end;
+    unsigned int addr;
+    int reg;
+    long v;
+
+    memcpy (lane->memory, mips.memory, sizeof (lane->memory));
+    memset (&lane->hart, 0, sizeof (Hart));
+    memcpy (lane->hart.registers, mips.registers, sizeof (lane->hart.registers));
+    lane->hart.link = -1;
+    lane->exitReason = EXIT_RUNNING;
+    lane->loop.pc = -1;
+    for (word = strtok (line, " \t\n"); word != NULL; word = strtok (NULL, " \t\n")) {
+        value = strchr (word, '=');
+        if (value == NULL) {
+            return 0;
+        }
+        *value++ = '\0';
+        v = strtol (value, &end, 0);
+        if (*value == '\0' || *end != '\0') {
+            return 0;
+        }
+        if (word[0] == '$') {
+            reg = strtol (word+1, &end, 10);
+            if (word[1] == '\0' || *end != '\0' || reg < 0 || reg > 31) {
+                return 0;
+            }
+            lane->hart.registers[reg] = v;
+        } else if (ParseAddress (word, &addr) && (addr & 3) == 0
+                   && INRANGE (INDEX ((int) addr))) {
+            lane->memory[INDEX ((int) addr)] = v;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void Report (Lane *lane, int instance) {
+    int k;
+
+    printf ("instance %d (line %d): %s after %ld instructions, $v0 = %d\n",
+        instance, lane->line, exitReasonNames[lane->exitReason],
+        lane->hart.instrCount, lane->hart.registers[2]);
+    if (mips.printingRegisters) {
+        for (k=0; k<32; k++) {
+            printf ("r%2.2d: %8.8x  ", k, lane->hart.registers[k]);
+            if ((k+1)%4 == 0) {
+                printf ("\n");
+            }
+        }
+    }
+}
+
+/*
+ *  Run the loaded program once for each instance in the inputs file at
+ *  path, LANES at a time, and report how each ended.  Return 0, or 1 if
+ *  any instance stopped abnormally.
+ */
+int Sweep (char *path) {
+    FILE *f = fopen (path, "r");
+    char line [MAXLINE];
+    int n = 0, lineNum = 0, instances = 0, l, status = 0;
+    struct timespec start, end;
+    double seconds;
+
+    if (f == NULL) {
+        fprintf (stderr, "Can't open file: %s\n", path);
+        exit (1);
+    }
+    lanes = calloc (LANES, sizeof (Lane));
+    shared = malloc (sizeof (DecodedImage));
+    if (lanes == NULL || shared == NULL) {
+        fprintf (stderr, "Out of memory for sweep lanes.\n");
+        exit (1);
+    }
+    limit = mips.maxInstr > 0 ? mips.maxInstr : LANELIMIT;
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    while (1) {
+        char *got = fgets (line, sizeof (line), f);
+        if (got != NULL) {
+            lineNum++;
+            if (line[strspn (line, " \t\n")] == '\0' || line[0] == '#') {
+                continue;
+            }
+            lanes[n].line = lineNum;
+            if (!ParseInstance (&lanes[n], line)) {
+                fprintf (stderr, "Bad assignment on line %d of %s.\n", lineNum, path);
+                exit (1);
+            }
+            n++;
+        }
+        if (n == LANES || (got == NULL && n > 0)) {
+            RunLanes (n);
+            for (l=0; l<n; l++) {
+                Report (&lanes[l], instances++);
+                status |= exitStatus[lanes[l].exitReason] != 0;
+            }
+            n = 0;
+        }
+        if (got == NULL) {
+            break;
+        }
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    fclose (f);
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf ("%d instances, %ld instructions, %.1f%% of them in groups of %d, "
+        "%.3f seconds\n", instances, laneInstrs,
+        laneInstrs > 0 ? 100.0 * groupInstrs / laneInstrs : 0.0, LANES, seconds);
+    free (lanes);
+    free (shared);
+    return status;
+}
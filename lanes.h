@@ -0,0 +1,23 @@
+
+/*
+ *  Parameter sweeps.  Many instances of the loaded program, differing
+ *  only in some initial registers or memory words, run LANES at a time
+ *  in lockstep.  Registers are kept struct-of-arrays, one vector per
+ *  register with a lane per instance, so each instruction is a single
+ *  vector operation across the group.  A lane whose branch or jr goes
+ *  the other way from the rest of the group is split off and finishes on
+ *  the scalar engine, as the whole group is when it reaches code it can't
+ *  share (a store into the program, or a pc outside it).  Syscalls, ll
+ *  and sc run one lane at a time, in lane order, without leaving the
+ *  group.
+ *
+ *  Each line of the inputs file is one instance: assignments such as
+ *  "$4=3 $5=0x10 result=0" to registers, or to memory words named by a
+ *  symbol or a hex address.  Blank lines and lines starting with # are
+ *  skipped.
+ */
+
+#define LANES 16		/* instances run as one group */
+#define LANELIMIT 100000000L	/* instructions per instance without --max-instr */
+
+int Sweep (char *path);
@@ -0,0 +1,14 @@
+# ll/sc across group steps, for "make sweeptest".
+#
+# The sc must find the reservation the ll made two instructions before,
+# so every instance ends with $t0 = 1 and the word incremented.
+#
+
+		.text
+		lui	$a0,0x40
+		ori	$a0,$a0,0x1000	# the first data word
+		ll	$t0,0($a0)
+		addiu	$t0,$t0,1
+		sc	$t0,0($a0)
+		ori	$v0,$0,10
+		syscall
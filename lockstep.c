@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "computer.h"
+#include "decode.h"
+#include "engine.h"
+#include "filter.h"
+#include "lockstep.h"
+#include "mipssim.h"
+#undef mips			/* gcc already has a def for mips */
+
+extern Computer mips;
+extern DecodedImage image;
+
+/* The candidate machine: a hart with memory and image of its own */
+static Hart cand;
+static int candMemory [IMAGEWORDS];
+static DecodedImage candImage;
+
+/* What one instruction did, as seen from each engine */
+typedef struct {
+    int running;
+    int pc;
+    int changedReg, regVal;
+    int changedMem, memVal;
+} Outcome;
+
+static void PrintOutcome (char *name, Outcome *o) {
+    printf ("  %-10s %s  pc %8.8x", name, o->running ? "ran    " : "stopped", o->pc);
+    if (o->changedReg != -1) {
+        printf ("  $%-2d = %8.8x", o->changedReg, o->regVal);
+    }
+    if (o->changedMem != -1) {
+        printf ("  [%8.8x] = %8.8x", o->changedMem, o->memVal);
+    }
+    printf ("\n");
+}
+
+/*
+ *  Print where the engines parted, what each did last, and every register
+ *  and memory word on which they now disagree.
+ */
+static void Divergence (long n, int pc, Outcome *ref, Outcome *can) {
+    int k;
+
+    printf ("Lockstep divergence at instruction %ld, pc %8.8x: %8.8x\n",
+        n, pc, mips.memory[(pc-0x00400000)/4]);
+    PrintOutcome ("reference", ref);
+    PrintOutcome ("candidate", can);
+    printf ("  %-8s %8s  %8s\n", "", "reference", "candidate");
+    for (k=0; k<32; k++) {
+        printf ("  $%-7d %8.8x   %8.8x%s\n", k, mips.registers[k],
+            cand.registers[k], mips.registers[k] != cand.registers[k] ? "  *" : "");
+    }
+    for (k=0; k<IMAGEWORDS; k++) {
+        if (mips.memory[k] != candMemory[k]) {
+            printf ("  %8.8x %8.8x   %8.8x  *\n", 0x00400000+4*k,
+                mips.memory[k], candMemory[k]);
+        }
+    }
+}
+
+/* Return 1 if the two outcomes agree. */
+static int Same (Outcome *ref, Outcome *can) {
+    return ref->running == can->running && ref->pc == can->pc
+        && ref->changedReg == can->changedReg && ref->regVal == can->regVal
+        && ref->changedMem == can->changedMem && ref->memVal == can->memVal;
+}
+
+static void Result (Outcome *o, int running, int pc, int *r, int *memory,
+    int changedReg, int changedMem) {
+    o->running = running;
+    o->pc = pc;
+    o->changedReg = running ? changedReg : -1;
+    o->regVal = o->changedReg != -1 ? r[changedReg] : 0;
+    o->changedMem = running ? changedMem : -1;
+    o->memVal = o->changedMem != -1 ? memory[(changedMem-0x00400000)/4] : 0;
+}
+
+/*
+ *  Run the loaded program on the reference pipeline and on the functional
+ *  engine together, for at most limit instructions (0 for no limit).
+ *  With block 1 the pc and the register and memory word each instruction
+ *  changed are compared after every instruction; with a larger block the
+ *  whole machine is compared after every block instructions, and the
+ *  candidate runs superinstructions that fit before the next comparison,
+ *  so they are checked too.  The run also ends, compared in full, where
+ *  CheckLimits would end the reference's.  Return 1 at the first
+ *  divergence, 0 if the engines agreed throughout.
+ */
+int Lockstep (long block, long limit) {
+    Outcome ref, can;
+    int pc, running = 1, refRunning, canRunning, changedReg, changedMem;
+    int ahead = 0;	/* instructions the candidate has already run */
+    LoopState loop = { -1, -1, 0 };
+    long n;
+
+    silent = 1;
+    LoadHart (&cand, &mips);
+    memcpy (candMemory, mips.memory, sizeof (candMemory));
+    memcpy (&candImage, &image, sizeof (candImage));
+
+    for (n=1; running && (limit == 0 || n <= limit); n++) {
+        pc = mips.pc;
+        refRunning = Step (&changedReg, &changedMem);
+        Result (&ref, refRunning, mips.pc, mips.registers, mips.memory,
+            changedReg, changedMem);
+
+        if (ahead > 0) {
+            /* the candidate ran this one as part of a superinstruction */
+            ahead--;
+            canRunning = 1;
+        } else if (block > 1 && fusing
+            && (ahead = StepSuper (&cand, candMemory, &candImage,
+                    block - (n-1) % block)) > 0) {
+            ahead--;
+            canRunning = 1;
+        } else if (refRunning && cand.pc == pc && INIMAGE (pc)
+            && candImage.op[(pc-0x00400000)/4] == 0x00
+            && candImage.funct[(pc-0x00400000)/4] == 0x0c) {
+            /*
+             *  Syscalls do I/O, so only the reference performs them; the
+             *  candidate takes over the $v0 it produced.
+             */
+            cand.registers[2] = mips.registers[2];
+            cand.pc = pc + 4;
+            cand.instrCount++;
+            canRunning = 1;
+        } else {
+            canRunning = StepHart (&cand, candMemory, &candImage,
+                &changedReg, &changedMem);
+        }
+        Result (&can, canRunning, cand.pc, cand.registers, candMemory,
+            changedReg, changedMem);
+        running = refRunning && canRunning;
+        /* not inside a superinstruction, or the candidate is ahead */
+        if (running && ahead == 0
+            && (mips.exitReason = CheckLimits (n, 0, pc, mips.pc, ref.changedReg,
+                    ref.changedMem, mips.registers, &loop)) != EXIT_RUNNING) {
+            running = 0;
+        }
+
+        if ((block == 1 && !Same (&ref, &can))
+            || ((n % block == 0 || !running)
+                && (mips.pc != cand.pc || refRunning != canRunning
+                    || memcmp (mips.registers, cand.registers,
+                        sizeof (cand.registers)) != 0
+                    || memcmp (mips.memory, candMemory,
+                        sizeof (candMemory)) != 0))) {
+            Divergence (n, pc, &ref, &can);
+            return 1;
+        }
+    }
+    printf ("Lockstep: %ld instructions, engines agree\n", n-1);
+    return 0;
+}
+
+/* xorshift32, so a seed gives the same program on every host */
+static unsigned int randState;
+
+static unsigned int Random (unsigned int n) {
+    randState ^= randState << 13;
+    randState ^= randState >> 17;
+    randState ^= randState << 5;
+    return randState % n;
+}
+
+/* Registers a generated instruction may write: all but $28 and $31 */
+static int DestReg () {
+    int reg = Random (30);
+    return reg < 28 ? reg : reg + 1;
+}
+
+#define RTYPE(rs,rt,rd,funct) (((rs)<<21)|((rt)<<16)|((rd)<<11)|(funct))
+#define ITYPE(op,rs,rt,imm) (((op)<<26)|((rs)<<21)|((rt)<<16)|((imm)&0xffff))
+#define JTYPE(op,index) (((op)<<26)|((0x00400000+4*(index))>>2))
+
+/*
+ *  Fill words[0] .. words[n-1] with a random program that cannot leave
+ *  its own code or touch memory out of range:
+ *    - $28 holds the data segment address and is never written; every
+ *      load and store addresses one of the first RANDOMDATA words from it
+ *    - branches and jumps only go forward, and never past the last word,
+ *      which is an unsupported instruction that ends the run
+ *    - $31 is only written by jal, and is set at the start, so jr always
+ *      returns into the program
+ *  Syscalls are left out; everything else the simulator supports is in.
+ */
+void RandomProgram (unsigned int seed, int *words, int n) {
+    static const int functs[] = { 0x21, 0x24, 0x25, 0x23, 0x2a, 0x00, 0x02, 0x08 };
+    static const int immOps[] = { 0x09, 0x0c, 0x0d, 0x0f };
+    static const int memOps[] = { 0x23, 0x2b, 0x30, 0x38 };
+    int k, land;
+
+    randState = seed ? seed : 1;
+    words[0] = ITYPE (0x0f, 0, 28, 0x0040);		/* lui $28, 0x40 */
+    words[1] = ITYPE (0x0d, 28, 28, 0x1000);	/* ori $28, $28, 0x1000 */
+    words[2] = JTYPE (0x03, 3);			/* jal 3 */
+    for (k=3; k<n-1; k++) {
+        land = k + 1 + Random (n - k - 1);
+        switch (Random (5)) {
+        case 0:
+            words[k] = RTYPE (Random (32), Random (32), DestReg (),
+                functs[Random (8)]);
+            break;
+        case 1:
+            words[k] = ITYPE (immOps[Random (4)], Random (32), DestReg (),
+                Random (0x10000));
+            break;
+        case 2:
+            /* a taken bne lands one word further on than beq would */
+            if (Random (2)) {
+                words[k] = ITYPE (0x04, Random (32), Random (32), land - (k + 1));
+            } else {
+                words[k] = ITYPE (0x05, Random (32), Random (32), land - (k + 2));
+            }
+            break;
+        case 3:
+            words[k] = ITYPE (memOps[Random (4)], 28, DestReg (),
+                4*Random (RANDOMDATA));
+            break;
+        case 4:
+            words[k] = JTYPE (Random (2) ? 0x02 : 0x03, land);
+            break;
+        }
+    }
+    words[n-1] = 0x20000000;
+}
+
+/*
+ *  Generate count programs from consecutive seeds and check each one in
+ *  lockstep.  A program that diverges is written out as random-SEED.dump
+ *  so it can be run on its own.  Return 1 if any diverged.
+ */
+int LockstepRandom (unsigned int seed, int count, long block) {
+    unsigned char bytes [4*RANDOMWORDS];
+    int words [RANDOMWORDS];
+    char name [32];
+    MipsSim *m = MipsCreate ();
+    FILE *f;
+    int k, j;
+
+    for (k=0; k<count; k++, seed++) {
+        RandomProgram (seed, words, RANDOMWORDS);
+        /* little-endian words, as in a dump file */
+        for (j=0; j<4*RANDOMWORDS; j++) {
+            bytes[j] = words[j/4] >> 8*(j%4);
+        }
+        MipsLoadBuffer (m, bytes, sizeof (bytes));
+        MipsInstall (m, 0, 0, 0, 0);
+        printf ("Seed %u: ", seed);
+        if (Lockstep (block, RANDOMLIMIT)) {
+            sprintf (name, "random-%u.dump", seed);
+            f = fopen (name, "w");
+            if (f != NULL) {
+                fwrite (bytes, 1, sizeof (bytes), f);
+                fclose (f);
+                printf ("Program written to %s\n", name);
+            }
+            MipsDestroy (m);
+            return 1;
+        }
+    }
+    MipsDestroy (m);
+    return 0;
+}
@@ -0,0 +1,16 @@
+
+/*
+ *  Differential checking.  The functional engine runs alongside the
+ *  staged reference pipeline on its own copy of the machine, and the two
+ *  are compared after every instruction (or every block of them).  The
+ *  first divergence stops the run with a dump of both states.  Random
+ *  programs over the supported instructions can drive the check.
+ */
+
+#define RANDOMWORDS 256		/* words in a generated program */
+#define RANDOMLIMIT 10000	/* instructions run per generated program */
+#define RANDOMDATA 64		/* data words generated loads and stores use */
+
+int Lockstep (long block, long limit);
+int LockstepRandom (unsigned int seed, int count, long block);
+void RandomProgram (unsigned int seed, int *words, int n);
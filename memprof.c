@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "computer.h"
+#include "decode.h"
+#include "memprof.h"
+
+#define INDEX(addr) (((addr) - 0x00400000) / 4)
+#define INRANGE(k) ((k) >= 0 && (k) < IMAGEWORDS)
+
+typedef struct {
+    int lastAddr;
+    long loads, stores, other;
+    int strides [STRIDESLOTS];
+    long counts [STRIDESLOTS];	/* 0 for a free slot */
+} PcProfile;
+
+int profilingMemory = 0;
+
+static PcProfile *pcs;		/* by memory index of the pc */
+static long reuse [REUSEBUCKETS];
+static int *lastUse;		/* time of the latest access to each word, or 0 */
+static int *tree;		/* Fenwick tree over times, 1 at each lastUse */
+static int now;			/* time of the latest access */
+static unsigned char touched [IMAGEWORDS/8];	/* words in this interval */
+static long interval;
+static int *workingSet, numIntervals, maxIntervals;
+
+void StartMemProfile () {
+    pcs = calloc (IMAGEWORDS, sizeof (PcProfile));
+    lastUse = calloc (IMAGEWORDS, sizeof (int));
+    tree = calloc (FENWICKSIZE, sizeof (int));
+    if (pcs == NULL || lastUse == NULL || tree == NULL) {
+        fprintf (stderr, "Out of memory for the memory profile.\n");
+        exit (1);
+    }
+    profilingMemory = 1;
+}
+
+static void Mark (int t, int delta) {
+    for (; t<FENWICKSIZE; t += t & -t) {
+        tree[t] += delta;
+    }
+}
+
+/* Marks at times 1 .. t */
+static int Marks (int t) {
+    int sum = 0;
+
+    for (; t>0; t -= t & -t) {
+        sum += tree[t];
+    }
+    return sum;
+}
+
+static int CompareLastUse (const void *a, const void *b) {
+    return lastUse[*(const int *) a] - lastUse[*(const int *) b];
+}
+
+/* Number the live marks 1, 2, ... again in the same order. */
+static void Renumber () {
+    static int words [IMAGEWORDS];
+    int k, n = 0;
+
+    for (k=0; k<IMAGEWORDS; k++) {
+        if (lastUse[k] != 0) {
+            words[n++] = k;
+        }
+    }
+    qsort (words, n, sizeof (int), CompareLastUse);
+    memset (tree, 0, FENWICKSIZE * sizeof (int));
+    for (k=0; k<n; k++) {
+        lastUse[words[k]] = k+1;
+        Mark (k+1, 1);
+    }
+    now = n;
+}
+
+/* Bucket 0 is a first use; then distance 0, 1, 2-3, 4-7, ... */
+static int Bucket (int distance) {
+    int b = 1;
+
+    while (distance > 0 && b < REUSEBUCKETS-1) {
+        distance >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void EndInterval () {
+    int k, n = 0;
+
+    for (k=0; k<IMAGEWORDS/8; k++) {
+        n += __builtin_popcount (touched[k]);
+    }
+    if (numIntervals == maxIntervals) {
+        maxIntervals = maxIntervals ? 2*maxIntervals : 1024;
+        workingSet = realloc (workingSet, maxIntervals * sizeof (int));
+        if (workingSet == NULL) {
+            fprintf (stderr, "Out of memory for the memory profile.\n");
+            exit (1);
+        }
+    }
+    workingSet[numIntervals++] = n;
+    memset (touched, 0, sizeof (touched));
+}
+
+/* Record a load (store 0) or store by the instruction at pc. */
+void ProfileAccess (int pc, int addr, int store, long instrCount) {
+    PcProfile *p = NULL;
+    int k = INDEX (addr), slot, stride;
+
+    if (INRANGE (INDEX (pc))) {
+        p = &pcs[INDEX (pc)];
+        if (p->loads + p->stores > 0) {
+            stride = addr - p->lastAddr;
+            for (slot=0; slot<STRIDESLOTS; slot++) {
+                if (p->counts[slot] == 0 || p->strides[slot] == stride) {
+                    break;
+                }
+            }
+            if (slot == STRIDESLOTS) {
+                p->other++;
+            } else {
+                p->strides[slot] = stride;
+                p->counts[slot]++;
+            }
+        }
+        p->lastAddr = addr;
+        if (store) {
+            p->stores++;
+        } else {
+            p->loads++;
+        }
+    }
+    if (!INRANGE (k)) {
+        return;
+    }
+
+    while (instrCount / WSINTERVAL > interval) {
+        EndInterval ();
+        interval++;
+    }
+    touched[k/8] |= 1 << (k%8);
+
+    if (now == FENWICKSIZE-1) {
+        Renumber ();
+    }
+    now++;
+    if (lastUse[k] == 0) {
+        reuse[0]++;
+    } else {
+        reuse[Bucket (Marks (now-1) - Marks (lastUse[k]))]++;
+        Mark (lastUse[k], -1);
+    }
+    Mark (now, 1);
+    lastUse[k] = now;
+}
+
+static void Put32 (FILE *f, unsigned int v) {
+    fputc (v, f);
+    fputc (v >> 8, f);
+    fputc (v >> 16, f);
+    fputc (v >> 24, f);
+}
+
+static void Put64 (FILE *f, unsigned long v) {
+    Put32 (f, v);
+    Put32 (f, v >> 32);
+}
+
+static long Accesses (const PcProfile *p) {
+    return p->loads + p->stores;
+}
+
+static int CompareAccesses (const void *a, const void *b) {
+    long x = Accesses (&pcs[*(const int *) a]), y = Accesses (&pcs[*(const int *) b]);
+    return (y > x) - (y < x);
+}
+
+/* Print the summary, and write the dump to path unless it is NULL. */
+void WriteMemProfile (char *path) {
+    static int order [IMAGEWORDS];
+    long loads = 0, stores = 0, sum = 0;
+    int k, slot, numPcs = 0, lo, hi, words = 0;
+    PcProfile *p;
+    FILE *f;
+
+    EndInterval ();
+    for (k=0; k<IMAGEWORDS; k++) {
+        words += lastUse[k] != 0;
+        if (Accesses (&pcs[k]) > 0) {
+            order[numPcs++] = k;
+            loads += pcs[k].loads;
+            stores += pcs[k].stores;
+        }
+    }
+    qsort (order, numPcs, sizeof (int), CompareAccesses);
+
+    printf ("Memory profile: %ld loads, %ld stores, %d distinct words\n",
+        loads, stores, words);
+    printf ("  reuse distance (distinct words between uses of a word):\n");
+    printf ("    first use  %ld\n", reuse[0]);
+    for (k=1; k<REUSEBUCKETS; k++) {
+        lo = k == 1 ? 0 : 1 << (k-2);
+        hi = k == 1 ? 0 : k == REUSEBUCKETS-1 ? IMAGEWORDS-1 : (1 << (k-1)) - 1;
+        if (reuse[k] > 0 && lo == hi) {
+            printf ("    %9d  %ld\n", lo, reuse[k]);
+        } else if (reuse[k] > 0) {
+            printf ("    %4d-%-4d  %ld\n", lo, hi, reuse[k]);
+        }
+    }
+    for (k=0, lo=IMAGEWORDS, hi=0; k<numIntervals; k++) {
+        lo = workingSet[k] < lo ? workingSet[k] : lo;
+        hi = workingSet[k] > hi ? workingSet[k] : hi;
+        sum += workingSet[k];
+    }
+    printf ("  working set per %d instructions: min %d, mean %.1f, max %d words "
+        "over %d intervals\n", WSINTERVAL, lo, (double) sum / numIntervals, hi,
+        numIntervals);
+    printf ("  strides of the busiest pcs:\n");
+    for (k=0; k<numPcs && k<HOTPCS; k++) {
+        p = &pcs[order[k]];
+        printf ("    %8.8x  %ld loads %ld stores ", 0x00400000 + 4*order[k],
+            p->loads, p->stores);
+        for (slot=0; slot<STRIDESLOTS && p->counts[slot]>0; slot++) {
+            printf (" %+d: %.1f%%", p->strides[slot],
+                100.0 * p->counts[slot] / (Accesses (p) - 1));
+        }
+        if (p->other > 0) {
+            printf (" other: %.1f%%", 100.0 * p->other / (Accesses (p) - 1));
+        }
+        printf ("\n");
+    }
+
+    if (path == NULL) {
+        return;
+    }
+    f = fopen (path, "wb");
+    if (f == NULL) {
+        fprintf (stderr, "Can't write memory profile: %s\n", path);
+        return;
+    }
+    fwrite ("MPF1", 4, 1, f);
+    Put32 (f, REUSEBUCKETS);
+    Put32 (f, numIntervals);
+    Put32 (f, numPcs);
+    for (k=0; k<REUSEBUCKETS; k++) {
+        Put64 (f, reuse[k]);
+    }
+    for (k=0; k<numIntervals; k++) {
+        Put32 (f, workingSet[k]);
+    }
+    for (k=0; k<numPcs; k++) {
+        p = &pcs[order[k]];
+        Put32 (f, 0x00400000 + 4*order[k]);
+        Put64 (f, p->loads);
+        Put64 (f, p->stores);
+        Put64 (f, p->other);
+        for (slot=0; slot<STRIDESLOTS; slot++) {
+            Put32 (f, p->strides[slot]);
+            Put64 (f, p->counts[slot]);
+        }
+    }
+    fclose (f);
+}
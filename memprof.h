@@ -0,0 +1,34 @@
+
+/*
+ *  Memory access profile.  Every word lw, sw, ll and sc touch is
+ *  recorded, independent of any cache configuration:
+ *
+ *  - per load/store pc, a histogram of strides between its successive
+ *    addresses (the first STRIDESLOTS different strides exactly, the
+ *    rest together as "other");
+ *  - the reuse distance of each access, the number of distinct words
+ *    touched since the last access to the same word, in power-of-two
+ *    buckets.  Distances come from a Fenwick tree over access times with
+ *    a mark at the latest access to each word, so each costs O(log n);
+ *  - the working set, distinct words touched, in each interval of
+ *    WSINTERVAL instructions.
+ *
+ *  The dump is little-endian: "MPF1", then 32-bit counts of reuse
+ *  buckets, working-set intervals and pcs; the reuse buckets as 64-bit
+ *  counts (cold misses first, then distance 0, 1, 2-3, 4-7, ...); the
+ *  working set of each interval as 32 bits; and for each pc its address,
+ *  loads, stores and other-stride count (64 bits but the address), then
+ *  STRIDESLOTS pairs of a 32-bit stride in bytes and a 64-bit count.
+ */
+
+#define STRIDESLOTS 4		/* strides kept exactly for each pc */
+#define REUSEBUCKETS 14		/* cold, 0, then powers of two below IMAGEWORDS */
+#define WSINTERVAL 10000	/* instructions per working-set sample */
+#define FENWICKSIZE 65536	/* access times before they are renumbered */
+#define HOTPCS 10		/* pcs listed in the report */
+
+extern int profilingMemory;
+
+void StartMemProfile ();
+void ProfileAccess (int pc, int addr, int store, long instrCount);
+void WriteMemProfile (char *path);
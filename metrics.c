@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "computer.h"
+#include "decode.h"
+#include "metrics.h"
+#undef mips			/* gcc already has a def for mips */
+
+extern Computer mips;
+
+Metrics metrics;
+int profiling = 1;
+
+const char *exitReasonNames[NUMEXITREASONS] = {
+    "running", "unsupported instruction", "exit syscall", "quit",
+    "instruction limit", "pc out of range", "self loop", "timeout"
+};
+
+/*
+ *  sim's exit status for each.  A program normally ends as one of the
+ *  three after running, the samples on an unsupported instruction, so
+ *  those are deliberately all 0; sim's usage text says so.
+ */
+const int exitStatus[NUMEXITREASONS] = { 0, 0, 0, 0, 2, 3, 4, 5 };
+
+static struct timespec wallStart, cpuStart;
+
+void StartMetrics () {
+    clock_gettime (CLOCK_MONOTONIC, &wallStart);
+    clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+}
+
+static double Since (clockid_t clock, struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime (clock, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Count one retired instruction of kind k; taken says if a branch was. */
+void CountInstr (InstrKind k, int taken) {
+    metrics.kinds[k]++;
+    switch (k) {
+    case K_LW: case K_LL:
+        metrics.loads++;
+        break;
+    case K_SW: case K_SC:
+        metrics.stores++;
+        break;
+    case K_BEQ: case K_BNE:
+        metrics.branches++;
+        metrics.taken += taken;
+        break;
+    case K_J: case K_JAL: case K_JR:
+        metrics.jumps++;
+        break;
+    default:
+        break;
+    }
+}
+
+/* FNV-1a over the data segment, so runs can be compared cheaply. */
+unsigned int DataChecksum (const int *memory, int *nonzero) {
+    unsigned int h = 2166136261u;
+    int k;
+
+    *nonzero = 0;
+    for (k=MAXNUMINSTRS; k<MAXNUMINSTRS+MAXNUMDATA; k++) {
+        h = (h ^ (unsigned int) memory[k]) * 16777619u;
+        *nonzero += memory[k] != 0;
+    }
+    return h;
+}
+
+static void WriteJson (FILE *f, double wall, double cpu) {
+    int k, nonzero, first;
+    unsigned int sum = DataChecksum (mips.memory, &nonzero);
+
+    fprintf (f, "{\n  \"instructions\": %ld,\n", mips.instrCount);
+    fprintf (f, "  \"exitReason\": \"%s\",\n", exitReasonNames[mips.exitReason]);
+    fprintf (f, "  \"pc\": %u,\n", (unsigned int) mips.pc);
+    fprintf (f, "  \"opcodes\": {");
+    for (k=0; k<NUMKINDS; k++) {
+        fprintf (f, "%s\"%s\": %ld", k ? ", " : "", kindNames[k], metrics.kinds[k]);
+    }
+    fprintf (f, "},\n  \"loads\": %ld,\n  \"stores\": %ld,\n",
+        metrics.loads, metrics.stores);
+    fprintf (f, "  \"branches\": {\"taken\": %ld, \"notTaken\": %ld},\n",
+        metrics.taken, metrics.branches - metrics.taken);
+    fprintf (f, "  \"jumps\": %ld,\n  \"registers\": [", metrics.jumps);
+    for (k=0; k<32; k++) {
+        fprintf (f, "%s%u", k ? ", " : "", (unsigned int) mips.registers[k]);
+    }
+    fprintf (f, "],\n  \"memory\": {\"nonzeroWords\": %d, \"checksum\": %u, "
+        "\"words\": [", nonzero, sum);
+    for (k=MAXNUMINSTRS, first=1; k<MAXNUMINSTRS+MAXNUMDATA; k++) {
+        if (mips.memory[k] != 0) {
+            fprintf (f, "%s\n    {\"addr\": %u, \"value\": %u}", first ? "" : ",",
+                0x00400000+4*k, (unsigned int) mips.memory[k]);
+            first = 0;
+        }
+    }
+    fprintf (f, "%s]},\n", first ? "" : "\n  ");
+    fprintf (f, "  \"wallSeconds\": %.6f,\n  \"cpuSeconds\": %.6f\n}\n", wall, cpu);
+}
+
+static void WriteCsv (FILE *f, double wall, double cpu) {
+    int k, nonzero;
+    unsigned int sum = DataChecksum (mips.memory, &nonzero);
+
+    fprintf (f, "instructions,exit_reason,pc");
+    for (k=0; k<NUMKINDS; k++) {
+        fprintf (f, ",op_%s", kindNames[k]);
+    }
+    fprintf (f, ",loads,stores,branches_taken,branches_not_taken,jumps");
+    for (k=0; k<32; k++) {
+        fprintf (f, ",r%d", k);
+    }
+    fprintf (f, ",nonzero_words,memory_checksum,wall_seconds,cpu_seconds\n");
+
+    fprintf (f, "%ld,%s,%u", mips.instrCount, exitReasonNames[mips.exitReason],
+        (unsigned int) mips.pc);
+    for (k=0; k<NUMKINDS; k++) {
+        fprintf (f, ",%ld", metrics.kinds[k]);
+    }
+    fprintf (f, ",%ld,%ld,%ld,%ld,%ld", metrics.loads, metrics.stores,
+        metrics.taken, metrics.branches - metrics.taken, metrics.jumps);
+    for (k=0; k<32; k++) {
+        fprintf (f, ",%u", (unsigned int) mips.registers[k]);
+    }
+    fprintf (f, ",%d,%u,%.6f,%.6f\n", nonzero, sum, wall, cpu);
+}
+
+void WriteMetrics (char *path) {
+    double wall = Since (CLOCK_MONOTONIC, &wallStart);
+    double cpu = Since (CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+    int n = strlen (path);
+    FILE *f = fopen (path, "w");
+
+    if (f == NULL) {
+        fprintf (stderr, "Can't open metrics file: %s\n", path);
+        exit (1);
+    }
+    if (n > 4 && strcmp (path + n - 4, ".csv") == 0) {
+        WriteCsv (f, wall, cpu);
+    } else {
+        WriteJson (f, wall, cpu);
+    }
+    fclose (f);
+}
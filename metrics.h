@@ -0,0 +1,24 @@
+
+/*
+ *  End-of-run report for tools rather than people.  The counters are
+ *  bumped by Step() as instructions retire; WriteMetrics adds the final
+ *  machine state and host timings and writes the lot as JSON, or as a
+ *  CSV header and row if the file name ends in .csv.
+ */
+
+typedef struct {
+    long kinds [NUMKINDS];	/* instructions retired, by kind */
+    long loads, stores;
+    long branches, taken;	/* beq/bne executed, and how many were taken */
+    long jumps;		/* j, jal and jr */
+} Metrics;
+
+extern Metrics metrics;
+extern int profiling;	/* Simulate counts instructions into metrics */
+extern const char *exitReasonNames[NUMEXITREASONS];
+extern const int exitStatus[NUMEXITREASONS];
+
+void StartMetrics ();
+void CountInstr (InstrKind k, int taken);
+void WriteMetrics (char *path);
+unsigned int DataChecksum (const int *memory, int *nonzero);
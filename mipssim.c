@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "computer.h"
+#include "decode.h"
+#include "engine.h"
+#include "mipssim.h"
+#include "elf.h"
+#undef mips			/* gcc already has a def for mips */
+
+extern Computer mips;
+
+#define INDEX(addr) (((addr) - 0x00400000) / 4)
+
+struct MipsSim {
+    Hart hart;
+    int memory [IMAGEWORDS];
+    DecodedImage image;
+    ExitReason exitReason;
+    MipsStepHook hook;
+    void *hookArg;
+    long *kinds;	/* instructions simulated by kind, or NULL */
+    long maxInstr;	/* stop once instrCount reaches this, 0 for no limit */
+    int stopped;	/* the hook asked to stop */
+    int textLo, textHi;	/* addresses of the loaded code */
+    ElfProgram elf;	/* what loading an executable found */
+    LoopState loop;	/* last branch to itself, see CheckLimits */
+};
+
+MipsSim *MipsCreate () {
+    MipsSim *m = calloc (1, sizeof (MipsSim));
+
+    if (m != NULL) {
+        MipsReset (m);
+    }
+    return m;
+}
+
+void MipsDestroy (MipsSim *m) {
+    FreeSymbols (&m->elf);
+    free (m);
+}
+
+/* A new machine in the same state as m, step hook and all. */
+MipsSim *MipsClone (MipsSim *m) {
+    MipsSim *c = malloc (sizeof (MipsSim));
+
+    if (c != NULL) {
+        memcpy (c, m, sizeof (MipsSim));
+        if (CopySymbols (&c->elf, &m->elf) != 0) {
+            free (c);
+            return NULL;
+        }
+    }
+    return c;
+}
+
+/*
+ *  Put the registers and pc back as InitComputer leaves them, keeping
+ *  memory as it is.
+ */
+void MipsReset (MipsSim *m) {
+    memset (m->hart.registers, 0, sizeof (m->hart.registers));
+    m->hart.registers[29] = 0x00400000 + IMAGEWORDS*4;
+    m->hart.pc = 0x00400000;
+    m->hart.instrCount = 0;
+    m->hart.link = -1;
+    m->exitReason = EXIT_RUNNING;
+    m->loop.pc = -1;
+}
+
+/* Finish loading a program whose code is at [textLo, textHi). */
+static void Loaded (MipsSim *m, int textLo, int textHi, int bigEndian) {
+    DecodeImage (m->memory, 0, IMAGEWORDS, 0x00400000, &m->image);
+    m->textLo = textLo;
+    m->textHi = textHi;
+    m->hart.bigEndian = bigEndian;
+    MipsReset (m);
+}
+
+/* Finish loading an executable, which LoadElf has described in m->elf. */
+static void LoadedElf (MipsSim *m) {
+    Loaded (m, m->elf.text[0], m->elf.text[1], m->elf.bigEndian);
+    m->hart.pc = m->elf.entry;
+}
+
+/*
+ *  Load a dump file, as sim does, or an ELF executable, which also sets
+ *  the pc to its entry point.  Returns MIPS_OK or an error.
+ */
+int MipsLoadFile (MipsSim *m, const char *path) {
+    FILE *filein = fopen (path, "r");
+    unsigned char magic [4];
+    int words;
+
+    if (filein == NULL) {
+        return MIPS_NOFILE;
+    }
+    if (fread (magic, 1, 4, filein) == 4 && IsElf (magic, 4)) {
+        fclose (filein);
+        if (LoadElfFile (path, m->memory, &m->elf) != 0) {
+            return MIPS_BADELF;
+        }
+        LoadedElf (m);
+        return MIPS_OK;
+    }
+    rewind (filein);
+    words = LoadProgram (filein, m->memory);
+    fclose (filein);
+    if (words < 0) {
+        return MIPS_TOOBIG;
+    }
+    FreeSymbols (&m->elf);
+    Loaded (m, 0x00400000, 0x00400000 + 4*words, 0);
+    return MIPS_OK;
+}
+
+/*
+ *  Load a data dump over the data segment of m, after its program, so
+ *  tables start initialized.  Returns MIPS_OK or an error.
+ */
+int MipsLoadData (MipsSim *m, const char *path) {
+    FILE *filein = fopen (path, "r");
+    int words;
+
+    if (filein == NULL) {
+        return MIPS_NOFILE;
+    }
+    words = LoadData (filein, m->memory);
+    fclose (filein);
+    if (words < 0) {
+        return MIPS_TOOBIG;
+    }
+    DecodeImage (m->memory, MAXNUMINSTRS, MAXNUMDATA, 0x00400000, &m->image);
+    return MIPS_OK;
+}
+
+/*
+ *  Load the contents of a dump file (little-endian words), or an ELF
+ *  executable, from memory.
+ */
+int MipsLoadBuffer (MipsSim *m, const void *bytes, long length) {
+    const unsigned char *b = bytes;
+    long k;
+
+    if (IsElf (b, length)) {
+        if (LoadElf (b, length, m->memory, &m->elf) != 0) {
+            return MIPS_BADELF;
+        }
+        LoadedElf (m);
+        return MIPS_OK;
+    }
+    if (length/4 > MAXNUMINSTRS) {
+        return MIPS_TOOBIG;
+    }
+    memset (m->memory, 0, sizeof (m->memory));
+    for (k=0; k+4<=length; k+=4) {
+        m->memory[k/4] = b[k] | b[k+1]<<8 | b[k+2]<<16 | (unsigned)b[k+3]<<24;
+    }
+    FreeSymbols (&m->elf);
+    Loaded (m, 0x00400000, 0x00400000 + 4*(length/4), 0);
+    return MIPS_OK;
+}
+
+/* Count the count instructions from pc, which have just been simulated. */
+static void CountKinds (MipsSim *m, int pc, int count) {
+    int k;
+
+    for (k=INDEX (pc); k<INDEX (pc)+count; k++) {
+        m->kinds[KindOf (m->image.op[k], m->image.funct[k])]++;
+    }
+}
+
+/*
+ *  Simulate up to n instructions.  Returns how many were simulated,
+ *  fewer than n if the program ended, ran off the end of memory, branched
+ *  to itself for good, reached MipsSetMaxInstr's limit, ran out of sim's
+ *  --timeout, or the step hook asked to stop.  A machine that has stopped stays stopped, and 0 are
+ *  simulated, until its pc, a register or memory is set.  With no hook
+ *  and no plugin to see each instruction, superinstructions run fused.
+ */
+long MipsStep (MipsSim *m, long n) {
+    long done;
+    int pc, changedReg, changedMem, fused;
+    StepFn step = SelectStep ();
+    int super = fusing && step == StepHart && m->hook == NULL;
+
+    m->stopped = 0;
+    if (m->exitReason != EXIT_RUNNING) {
+        return 0;
+    }
+    if (m->maxInstr > 0) {
+        if (m->hart.instrCount >= m->maxInstr) {
+            m->exitReason = EXIT_MAXINSTR;
+            return 0;
+        }
+        /* so a superinstruction can't run past the limit */
+        if (n > m->maxInstr - m->hart.instrCount) {
+            n = m->maxInstr - m->hart.instrCount;
+        }
+    }
+    for (done=0; done<n; done++) {
+        pc = m->hart.pc;
+        if (super && (fused = StepSuper (&m->hart, m->memory, &m->image,
+                n - done)) > 0) {
+            if (m->kinds != NULL) {
+                CountKinds (m, pc, fused);
+            }
+            done += fused - 1;
+            /* only the last can branch, and to itself it never leaves */
+            if (m->hart.pc == pc + 4*(fused-1)) {
+                m->exitReason = EXIT_SELFLOOP;
+                done++;
+                break;
+            }
+            if ((m->exitReason = CheckLimits (m->hart.instrCount, m->maxInstr,
+                    -1, 0, -1, -1, m->hart.registers, &m->loop)) != EXIT_RUNNING) {
+                done++;
+                break;
+            }
+            continue;
+        }
+        if (!step (&m->hart, m->memory, &m->image,
+                &changedReg, &changedMem)) {
+            m->exitReason = StopReason (&m->image, pc);
+            break;
+        }
+        if (m->kinds != NULL) {
+            CountKinds (m, pc, 1);
+        }
+        if ((m->exitReason = CheckLimits (m->hart.instrCount, m->maxInstr, pc,
+                m->hart.pc, changedReg, changedMem, m->hart.registers,
+                &m->loop)) != EXIT_RUNNING) {
+            done++;
+            break;
+        }
+        if (m->hook != NULL
+            && m->hook (m, pc, changedReg, changedMem, m->hookArg)) {
+            m->stopped = 1;
+            done++;
+            break;
+        }
+    }
+    return done;
+}
+
+/*
+ *  Simulate until the pc reaches the given address (-1 for none) or the
+ *  instruction count reaches count (0 for no limit).  At least one
+ *  instruction is simulated.  Returns how many were.
+ */
+long MipsRunUntil (MipsSim *m, int pc, long count) {
+    long done = 0;
+
+    do {
+        if (MipsStep (m, 1) == 0) {
+            break;
+        }
+        done++;
+    } while (!m->stopped && m->hart.pc != pc
+             && (count == 0 || m->hart.instrCount < count));
+    return done;
+}
+
+void MipsSetStepHook (MipsSim *m, MipsStepHook hook, void *arg) {
+    m->hook = hook;
+    m->hookArg = arg;
+}
+
+/*
+ *  Add every instruction m simulates from now on to kinds, indexed by
+ *  InstrKind, or stop counting if kinds is NULL.  Unlike a step hook
+ *  this leaves superinstructions fused.
+ */
+void MipsCountKinds (MipsSim *m, long *kinds) {
+    m->kinds = kinds;
+}
+
+/*
+ *  Stop the program once it has run maxInstr instructions in all, as
+ *  sim's --max-instr does, with the exit reason EXIT_MAXINSTR.  0 is no
+ *  limit.
+ */
+void MipsSetMaxInstr (MipsSim *m, long maxInstr) {
+    m->maxInstr = maxInstr;
+}
+
+/*
+ *  Have syscalls read from in and print to out instead of the simulator's
+ *  input and stdout.  NULL puts either back.
+ */
+void MipsSetIO (MipsSim *m, FILE *in, FILE *out) {
+    m->hart.in = in;
+    m->hart.out = out;
+}
+
+int MipsGetReg (MipsSim *m, int reg) {
+    return m->hart.registers[reg & 31];
+}
+
+void MipsSetReg (MipsSim *m, int reg, int value) {
+    m->hart.registers[reg & 31] = value;
+    m->exitReason = EXIT_RUNNING;
+}
+
+int MipsGetPc (MipsSim *m) {
+    return m->hart.pc;
+}
+
+void MipsSetPc (MipsSim *m, int pc) {
+    m->hart.pc = pc;
+    m->exitReason = EXIT_RUNNING;
+}
+
+/* Read a word.  Returns 0, or -1 if addr is not a word of memory. */
+int MipsReadMem (MipsSim *m, int addr, int *value) {
+    int k = INDEX (addr);
+
+    if ((addr & 3) != 0 || k < 0 || k >= IMAGEWORDS) {
+        return -1;
+    }
+    *value = m->memory[k];
+    return 0;
+}
+
+/* Write a word, which may be an instruction.  Returns as MipsReadMem. */
+int MipsWriteMem (MipsSim *m, int addr, int value) {
+    int k = INDEX (addr);
+
+    if ((addr & 3) != 0 || k < 0 || k >= IMAGEWORDS) {
+        return -1;
+    }
+    m->memory[k] = value;
+    DecodeImageScalar (m->memory, k, 1, 0x00400000, &m->image);
+    m->exitReason = EXIT_RUNNING;
+    return 0;
+}
+
+long MipsInstrCount (MipsSim *m) {
+    return m->hart.instrCount;
+}
+
+int MipsExitReason (MipsSim *m) {
+    return m->exitReason;
+}
+
+/* Why the last MipsLoadFile or MipsLoadBuffer gave MIPS_BADELF */
+const char *MipsLoadError (MipsSim *m) {
+    return m->elf.error;
+}
+
+/* Whether bytes within each word of memory are in big-endian order */
+int MipsBigEndian (MipsSim *m) {
+    return m->hart.bigEndian;
+}
+
+/* All of memory, IMAGEWORDS words from 0x00400000, for reading. */
+const int *MipsMemory (MipsSim *m) {
+    return m->memory;
+}
+
+/* Make m's program and registers those of the staged simulator. */
+void MipsInstall (MipsSim *m, int printingRegisters, int printingMemory,
+    int debugging, int interactive) {
+    InitComputer (m->memory, printingRegisters, printingMemory,
+        debugging, interactive);
+    StoreHart (&m->hart, &mips);
+    mips.textLo = m->textLo;
+    mips.textHi = m->textHi;
+    mips.program = &m->elf;
+}
@@ -0,0 +1,55 @@
+
+/*
+ *  libmipssim: the simulator as a library.  A MipsSim is a complete
+ *  machine (registers, pc, memory and its decoded image) that is stepped
+ *  by the functional engine, so any number of them can exist at once and
+ *  be driven from different threads.  MipsInstall hands a machine to the
+ *  staged simulator (tracing, interactive mode, undo, harts, lockstep),
+ *  of which there is only one.
+ */
+
+typedef struct MipsSim MipsSim;
+
+/*
+ *  Called after every instruction a machine simulates, with the pc of
+ *  that instruction and the register and memory address it changed (-1
+ *  for none).  Returning nonzero stops MipsStep or MipsRunUntil there.
+ */
+typedef int (*MipsStepHook) (MipsSim *m, int pc, int changedReg,
+    int changedMem, void *arg);
+
+/* MipsLoadFile and MipsLoadBuffer results */
+#define MIPS_OK 0
+#define MIPS_NOFILE (-1)	/* the file could not be opened */
+#define MIPS_TOOBIG (-2)	/* more words than the segment holds */
+#define MIPS_BADELF (-3)	/* an ELF file that can't be loaded, see MipsLoadError */
+
+MipsSim *MipsCreate ();
+void MipsDestroy (MipsSim *m);
+MipsSim *MipsClone (MipsSim *m);
+int MipsLoadFile (MipsSim *m, const char *path);
+int MipsLoadBuffer (MipsSim *m, const void *bytes, long length);
+int MipsLoadData (MipsSim *m, const char *path);
+void MipsReset (MipsSim *m);
+
+long MipsStep (MipsSim *m, long n);
+long MipsRunUntil (MipsSim *m, int pc, long count);
+void MipsSetStepHook (MipsSim *m, MipsStepHook hook, void *arg);
+void MipsCountKinds (MipsSim *m, long *kinds);
+void MipsSetMaxInstr (MipsSim *m, long maxInstr);
+void MipsSetIO (MipsSim *m, FILE *in, FILE *out);
+
+int MipsGetReg (MipsSim *m, int reg);
+void MipsSetReg (MipsSim *m, int reg, int value);
+int MipsGetPc (MipsSim *m);
+void MipsSetPc (MipsSim *m, int pc);
+int MipsReadMem (MipsSim *m, int addr, int *value);
+int MipsWriteMem (MipsSim *m, int addr, int value);
+long MipsInstrCount (MipsSim *m);
+int MipsExitReason (MipsSim *m);	/* an ExitReason from computer.h */
+const char *MipsLoadError (MipsSim *m);
+int MipsBigEndian (MipsSim *m);
+const int *MipsMemory (MipsSim *m);
+
+void MipsInstall (MipsSim *m, int printingRegisters, int printingMemory,
+    int debugging, int interactive);
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "plugin.h"
+
+/*
+ *  Example plugin: counts instructions, loads and stores, branches and how
+ *  many were taken, and writes to each register.  Load it with
+ *  "--plugin ./opcount.so" or "--plugin ./opcount.so:FILE" to report to
+ *  FILE instead of stderr.
+ */
+
+typedef struct {
+    long instrs, loads, stores, branches, taken;
+    long regWrites [32];
+    const char *report;
+} Counts;
+
+static void Fetch (void *data, int pc, int instr) {
+    ((Counts *) data)->instrs++;
+}
+
+static void MemRead (void *data, int pc, int addr, int value) {
+    ((Counts *) data)->loads++;
+}
+
+static void MemWrite (void *data, int pc, int addr, int value) {
+    ((Counts *) data)->stores++;
+}
+
+static void RegWrite (void *data, int pc, int reg, int value) {
+    ((Counts *) data)->regWrites[reg]++;
+}
+
+static void Branch (void *data, int pc, int target, int taken) {
+    Counts *c = data;
+
+    c->branches++;
+    c->taken += taken;
+}
+
+static void Finish (void *data) {
+    Counts *c = data;
+    FILE *out = *c->report ? fopen (c->report, "w") : stderr;
+    int k;
+
+    if (out == NULL) {
+        fprintf (stderr, "Can't write %s.\n", c->report);
+        return;
+    }
+    fprintf (out, "%ld instructions, %ld loads, %ld stores, "
+        "%ld branches (%ld taken)\n", c->instrs, c->loads, c->stores,
+        c->branches, c->taken);
+    for (k=0; k<32; k++) {
+        if (c->regWrites[k] != 0) {
+            fprintf (out, "  $%d written %ld times\n", k, c->regWrites[k]);
+        }
+    }
+    if (out != stderr) {
+        fclose (out);
+    }
+}
+
+int MipsPluginInit (Plugin *p, const char *arg) {
+    Counts *c = calloc (1, sizeof (Counts));
+
+    if (c == NULL) {
+        return 1;
+    }
+    c->report = arg;
+    p->fetch = Fetch;
+    p->memRead = MemRead;
+    p->memWrite = MemWrite;
+    p->regWrite = RegWrite;
+    p->branch = Branch;
+    p->finish = Finish;
+    p->data = c;
+    return 0;
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "computer.h"
+#include "decode.h"
+#include "engine.h"
+#include "input.h"
+#include "metrics.h"
+#include "mipssim.h"
+#include "elf.h"
+#include "os.h"
+#undef mips			/* gcc already has a def for mips */
+
+#define INDEX(addr) (((addr) - 0x00400000) / 4)
+#define INRANGE(k) ((k) >= 0 && (k) < IMAGEWORDS)
+
+extern Computer mips;
+
+/* A program file, loaded once however many processes run it */
+typedef struct {
+    char *path;
+    Computer initial;
+    DecodedImage image;
+} Program;
+
+typedef struct {
+    Computer c;
+    Program *program;
+    DecodedImage *image;	/* the program's, until the process needs its own */
+    long slices;	/* times it was scheduled */
+    long blocks;	/* times it waited for input */
+    long finished;	/* instructions all processes had run when it stopped */
+    LoopState loop;
+} Process;
+
+static Program *programs;
+static int numPrograms;
+static Process *procs;
+static int numProcs;
+static int printingRegisters;
+
+/* Load path unless it is already loaded.  Exits if it can't be. */
+static Program *LoadProcessProgram (MipsSim *loader, char *path) {
+    Program *p;
+    int k;
+
+    for (k=0; k<numPrograms; k++) {
+        if (strcmp (programs[k].path, path) == 0) {
+            return &programs[k];
+        }
+    }
+    switch (MipsLoadFile (loader, path)) {
+    case MIPS_NOFILE:
+        fprintf (stderr, "Can't open file: %s\n", path);
+        exit (1);
+    case MIPS_TOOBIG:
+        fprintf (stderr, "Program too big: %s\n", path);
+        exit (1);
+    case MIPS_BADELF:
+        fprintf (stderr, "Can't load %s: %s.\n", path, MipsLoadError (loader));
+        exit (1);
+    }
+    p = &programs[numPrograms++];
+    p->path = path;
+    MipsInstall (loader, 0, 0, 0, 0);
+    p->initial = mips;
+    /* the symbols are the loader's, which goes once everything is loaded */
+    p->initial.program = NULL;
+    DecodeImage (p->initial.memory, 0, IMAGEWORDS, 0x00400000, &p->image);
+    return p;
+}
+
+/* Give a process an image of its own memory, to change as it likes. */
+static void Unshare (Process *p) {
+    p->image = malloc (sizeof (DecodedImage));
+    if (p->image == NULL) {
+        fprintf (stderr, "Out of memory for processes.\n");
+        exit (1);
+    }
+    DecodeImage (p->c.memory, 0, IMAGEWORDS, 0x00400000, p->image);
+}
+
+/*
+ *  Run p for up to quantum instructions; clock counts every instruction
+ *  run by any process.  Return 1 if it blocked on a read.  A fresh Hart
+ *  is loaded each time, so ll reservations do not survive a context
+ *  switch, as on a real processor.
+ */
+static int Slice (Process *p, long quantum, long *clock) {
+    Hart h;
+    int pc, k, changedReg, changedMem, blocked = 0;
+    long n;
+
+    LoadHart (&h, &p->c);
+    for (n=0; n<quantum; n++) {
+        pc = h.pc;
+        k = INDEX (pc);
+        if (p->image == &p->program->image
+            && (pc < p->c.textLo || pc >= p->c.textHi)) {
+            Unshare (p);
+        }
+        if (INRANGE (k) && p->image->op[k] == 0x00 && p->image->funct[k] == 0x0c
+            && h.registers[2] == 5 && !InputReady ()) {
+            blocked = 1;
+            break;
+        }
+        if (!StepHart (&h, p->c.memory, p->image, &changedReg, &changedMem)) {
+            p->c.exitReason = StopReason (p->image, pc);
+            break;
+        }
+        (*clock)++;
+        if (changedMem >= p->c.textLo && changedMem < p->c.textHi
+            && p->image == &p->program->image) {
+            /* StepHart redecoded the shared word from this process's memory */
+            DecodeImageScalar (p->program->initial.memory, INDEX (changedMem), 1,
+                0x00400000, &p->program->image);
+            Unshare (p);
+        }
+        p->c.exitReason = CheckLimits (h.instrCount, p->c.maxInstr, pc, h.pc,
+            changedReg, changedMem, h.registers, &p->loop);
+        if (p->c.exitReason != EXIT_RUNNING) {
+            break;
+        }
+    }
+    StoreHart (&h, &p->c);
+    p->slices++;
+    return blocked;
+}
+
+static void Report (long quantum, long clock, long switches) {
+    Process *p;
+    int k, r;
+
+    printf ("%d processes, %ld instructions, quantum %ld, %ld context switches\n",
+        numProcs, clock, quantum, switches);
+    printf ("  pid  instructions  slices  blocked   finished     waited  exit\n");
+    for (k=0; k<numProcs; k++) {
+        p = &procs[k];
+        printf ("%5d  %12ld  %6ld  %7ld  %9ld  %9ld  %s (%s)\n", k,
+            p->c.instrCount, p->slices, p->blocks, p->finished,
+            p->finished - p->c.instrCount, exitReasonNames[p->c.exitReason],
+            p->program->path);
+        if (printingRegisters) {
+            for (r=0; r<32; r++) {
+                printf ("r%2.2d: %8.8x  ", r, p->c.registers[r]);
+                if ((r+1)%4 == 0) {
+                    printf ("\n");
+                }
+            }
+        }
+    }
+}
+
+/*
+ *  Run a process for each of the numPaths program files, all at once,
+ *  switching every quantum instructions, and report on each when all
+ *  have stopped.  No process runs more than maxInstr instructions, if
+ *  that is not 0.  Return sim's exit status for the first process that
+ *  stopped abnormally, or 0 if none did.
+ */
+int RunProcesses (char **paths, int numPaths, long quantum, long maxInstr,
+    int printing) {
+    MipsSim *loader = MipsCreate ();
+    long clock = 0, switches = 0;
+    int *ready, *blocked, numReady, numBlocked = 0, head = 0, alive, k, status = 0;
+    Process *p;
+
+    programs = calloc (numPaths, sizeof (Program));
+    procs = calloc (numPaths, sizeof (Process));
+    ready = malloc (numPaths * sizeof (int));
+    blocked = malloc (numPaths * sizeof (int));
+    if (loader == NULL || programs == NULL || procs == NULL || ready == NULL
+        || blocked == NULL) {
+        fprintf (stderr, "Out of memory for processes.\n");
+        exit (1);
+    }
+    for (k=0; k<numPaths; k++) {
+        procs[k].program = LoadProcessProgram (loader, paths[k]);
+        procs[k].c = procs[k].program->initial;
+        procs[k].c.maxInstr = maxInstr;
+        procs[k].loop.pc = -1;
+        procs[k].image = &procs[k].program->image;
+        ready[k] = k;
+    }
+    MipsDestroy (loader);
+    mips.program = NULL;
+    printingRegisters = printing;
+    numProcs = alive = numReady = numPaths;
+    /* unbuffered, so InputReady sees every line not yet read */
+    setvbuf (stdin, NULL, _IONBF, 0);
+
+    /* ready is a circular queue from head; blocked is in arrival order */
+    while (alive > 0) {
+        if (numBlocked > 0 && (numReady == 0 || InputReady ())) {
+            if (numReady == 0) {
+                WaitForInput ();
+            }
+            ready[(head + numReady++) % numPaths] = blocked[0];
+            memmove (blocked, blocked+1, --numBlocked * sizeof (int));
+        }
+        p = &procs[ready[head]];
+        head = (head + 1) % numPaths;
+        numReady--;
+        if (Slice (p, quantum, &clock)) {
+            p->blocks++;
+            blocked[numBlocked++] = p - procs;
+        } else if (p->c.exitReason != EXIT_RUNNING) {
+            p->finished = clock;
+            alive--;
+            if (status == 0) {
+                status = exitStatus[p->c.exitReason];
+            }
+        } else {
+            ready[(head + numReady++) % numPaths] = p - procs;
+        }
+        switches++;
+    }
+
+    Report (quantum, clock, switches);
+    for (k=0; k<numProcs; k++) {
+        if (procs[k].image != &procs[k].program->image) {
+            free (procs[k].image);
+        }
+    }
+    free (procs);
+    free (programs);
+    free (ready);
+    free (blocked);
+    return status;
+}
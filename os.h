@@ -0,0 +1,13 @@
+
+/*
+ *  Mini-OS mode.  Many programs run as processes in one host thread,
+ *  each a Computer of its own (memory, registers and pc) stepped by the
+ *  functional engine.  The scheduler is round-robin: a process runs for
+ *  a quantum of instructions, or until it reaches a read (syscall 5)
+ *  with no input waiting, in which case it blocks and the next one runs.
+ *  Processes of the same program share its decoded image until one
+ *  stores into its code or runs outside it.
+ */
+
+int RunProcesses (char **paths, int numPaths, long quantum, long maxInstr,
+    int printingRegisters);
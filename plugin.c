@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include "plugin.h"
+
+int hookMask = 0;
+
+static Plugin plugins [MAXPLUGINS];
+static int numPlugins = 0;
+
+/*
+ *  Load the plugin named by spec, "path" or "path:arg".  Return 0, or -1
+ *  after saying why on stderr.
+ */
+int LoadPlugin (const char *spec) {
+    char path [1024];
+    const char *arg = strchr (spec, ':');
+    int (*init) (Plugin *, const char *);
+    void *handle;
+    Plugin *p;
+
+    if (numPlugins == MAXPLUGINS) {
+        fprintf (stderr, "Too many plugins, at most %d.\n", MAXPLUGINS);
+        return -1;
+    }
+    snprintf (path, sizeof (path), "%.*s",
+        arg != NULL ? (int) (arg - spec) : (int) strlen (spec), spec);
+    /* dlopen only searches the library path for names without a slash */
+    if (strchr (path, '/') == NULL && strlen (path) + 2 < sizeof (path)) {
+        memmove (path+2, path, strlen (path)+1);
+        memcpy (path, "./", 2);
+    }
+    handle = dlopen (path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf (stderr, "Can't load plugin: %s.\n", dlerror ());
+        return -1;
+    }
+    *(void **) &init = dlsym (handle, "MipsPluginInit");
+    if (init == NULL) {
+        fprintf (stderr, "%s has no MipsPluginInit.\n", path);
+        dlclose (handle);
+        return -1;
+    }
+    p = &plugins[numPlugins];
+    memset (p, 0, sizeof (Plugin));
+    if (init (p, arg != NULL ? arg+1 : "") != 0) {
+        fprintf (stderr, "Plugin %s failed to start.\n", path);
+        dlclose (handle);
+        return -1;
+    }
+    numPlugins++;
+    hookMask |= (p->fetch ? HOOK_FETCH : 0) | (p->decode ? HOOK_DECODE : 0)
+        | (p->memRead ? HOOK_MEMREAD : 0) | (p->memWrite ? HOOK_MEMWRITE : 0)
+        | (p->regWrite ? HOOK_REGWRITE : 0) | (p->branch ? HOOK_BRANCH : 0);
+    return 0;
+}
+
+/* Let every plugin report, in the order they were loaded. */
+void FinishPlugins (void) {
+    int k;
+
+    for (k=0; k<numPlugins; k++) {
+        if (plugins[k].finish != NULL) {
+            plugins[k].finish (plugins[k].data);
+        }
+    }
+}
+
+/* Pass an event to each plugin that subscribes to it. */
+void HookFetch (int pc, int instr) {
+    int k;
+
+    for (k=0; k<numPlugins; k++) {
+        if (plugins[k].fetch != NULL) {
+            plugins[k].fetch (plugins[k].data, pc, instr);
+        }
+    }
+}
+
+void HookDecode (int pc, int kind) {
+    int k;
+
+    for (k=0; k<numPlugins; k++) {
+        if (plugins[k].decode != NULL) {
+            plugins[k].decode (plugins[k].data, pc, kind);
+        }
+    }
+}
+
+void HookMemRead (int pc, int addr, int value) {
+    int k;
+
+    for (k=0; k<numPlugins; k++) {
+        if (plugins[k].memRead != NULL) {
+            plugins[k].memRead (plugins[k].data, pc, addr, value);
+        }
+    }
+}
+
+void HookMemWrite (int pc, int addr, int value) {
+    int k;
+
+    for (k=0; k<numPlugins; k++) {
+        if (plugins[k].memWrite != NULL) {
+            plugins[k].memWrite (plugins[k].data, pc, addr, value);
+        }
+    }
+}
+
+void HookRegWrite (int pc, int reg, int value) {
+    int k;
+
+    for (k=0; k<numPlugins; k++) {
+        if (plugins[k].regWrite != NULL) {
+            plugins[k].regWrite (plugins[k].data, pc, reg, value);
+        }
+    }
+}
+
+void HookBranch (int pc, int target, int taken) {
+    int k;
+
+    for (k=0; k<numPlugins; k++) {
+        if (plugins[k].branch != NULL) {
+            plugins[k].branch (plugins[k].data, pc, target, taken);
+        }
+    }
+}
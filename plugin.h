@@ -0,0 +1,47 @@
+
+/*
+ *  Instrumentation plugins.  A plugin is a shared object exporting
+ *
+ *	int MipsPluginInit (Plugin *p, const char *arg);
+ *
+ *  which fills in the callbacks it wants (leaving the rest NULL) and
+ *  returns 0, or nonzero to refuse to load.  Callbacks run on the
+ *  functional engine, from whichever thread steps the hart, and get
+ *  p->data back as their first argument.  The engine is compiled once
+ *  for every combination of events, and the one matching the events
+ *  the loaded plugins subscribe to is chosen when stepping starts, so
+ *  an event nobody subscribes to costs nothing.
+ */
+
+#define HOOK_FETCH 1
+#define HOOK_DECODE 2
+#define HOOK_MEMREAD 4
+#define HOOK_MEMWRITE 8
+#define HOOK_REGWRITE 16
+#define HOOK_BRANCH 32
+#define NUMHOOKMASKS 64
+
+#define MAXPLUGINS 8
+
+typedef struct {
+    void (*fetch) (void *data, int pc, int instr);
+    void (*decode) (void *data, int pc, int kind);	/* an InstrKind */
+    void (*memRead) (void *data, int pc, int addr, int value);
+    void (*memWrite) (void *data, int pc, int addr, int value);
+    void (*regWrite) (void *data, int pc, int reg, int value);
+    /* beq, bne, j, jal and jr; target is where a taken branch goes */
+    void (*branch) (void *data, int pc, int target, int taken);
+    void (*finish) (void *data);	/* the run is over: report */
+    void *data;
+} Plugin;
+
+extern int hookMask;	/* events some loaded plugin subscribes to */
+
+int LoadPlugin (const char *spec);
+void FinishPlugins (void);
+void HookFetch (int pc, int instr);
+void HookDecode (int pc, int kind);
+void HookMemRead (int pc, int addr, int value);
+void HookMemWrite (int pc, int addr, int value);
+void HookRegWrite (int pc, int reg, int value);
+void HookBranch (int pc, int target, int taken);
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "mipssim.h"
+#include "sample.h"
+
+static void InitModel (TimingModel *t) {
+    memset (t, 0, sizeof (TimingModel));
+    t->loadDest = -1;
+}
+
+/* Look addr up in a direct-mapped cache, filling the line on a miss. */
+static int Miss (unsigned int *cache, int addr) {
+    unsigned int tag = (unsigned int) addr / LINEBYTES + 1;
+    unsigned int *line = &cache[tag % CACHELINES];
+
+    if (*line == tag) {
+        return 0;
+    }
+    *line = tag;
+    return 1;
+}
+
+/*
+ *  Simulate one instruction functionally and charge its cycles to the
+ *  timing model.  Return 0 if the program has ended.
+ */
+static int Timed (TimingModel *t, MipsSim *m) {
+    int pc = MipsGetPc (m), instr, op, rs, rt, addr, taken;
+    unsigned char *counter;
+
+    if (MipsReadMem (m, pc, &instr) != 0) {
+        return 0;
+    }
+    op = (instr >> 26) & 0x3f;
+    rs = (instr >> 21) & 0x1f;
+    rt = (instr >> 16) & 0x1f;
+    addr = MipsGetReg (m, rs) + (short) instr;
+    if (MipsStep (m, 1) == 0) {
+        return 0;
+    }
+    taken = MipsGetPc (m) != pc + 4;
+
+    t->cycles += 1 + MISSPENALTY * Miss (t->icache, pc);
+    if (t->loadDest > 0 && (rs == t->loadDest || rt == t->loadDest)) {
+        t->cycles += LOADUSEPENALTY;
+    }
+    t->loadDest = -1;
+    switch (op) {
+    case 0x23:		/* lw */
+    case 0x30:		/* ll */
+        t->cycles += MISSPENALTY * Miss (t->dcache, addr);
+        t->loadDest = rt;
+        break;
+    case 0x2b:		/* sw */
+    case 0x38:		/* sc */
+        t->cycles += MISSPENALTY * Miss (t->dcache, addr);
+        break;
+    case 0x04:		/* beq */
+    case 0x05:		/* bne */
+        counter = &t->counters[((unsigned int) pc >> 2) % PREDICTORSIZE];
+        if ((*counter >= 2) != taken) {
+            t->cycles += BRANCHPENALTY;
+        }
+        if (taken && *counter < 3) {
+            (*counter)++;
+        } else if (!taken && *counter > 0) {
+            (*counter)--;
+        }
+        break;
+    case 0x02:		/* j */
+    case 0x03:		/* jal */
+        t->cycles += JUMPPENALTY;
+        break;
+    case 0x00:
+        if ((instr & 0x3f) == 0x08) {	/* jr */
+            t->cycles += JUMPPENALTY;
+        }
+        break;
+    }
+    return 1;
+}
+
+/* Run up to n instructions through the model.  Return how many ran. */
+static long RunTimed (TimingModel *t, MipsSim *m, long n) {
+    long k;
+
+    for (k=0; k<n && Timed (t, m); k++) {
+    }
+    return k;
+}
+
+/*
+ *  Every period instructions, run warmup instructions through the timing
+ *  model to bring its caches and predictor back up to date, then measure
+ *  the next detail; the rest of the period is fast-forwarded.  With
+ *  warmup 0 and detail equal to period the whole run is timed.
+ */
+void SamplePeriodic (MipsSim *m, long period, long warmup, long detail) {
+    TimingModel t;
+    double cpi, sum = 0, sumSq = 0, mean, halfWidth = 0;
+    long fastForward = period - warmup - detail, cycles, done;
+    int n = 0;
+
+    InitModel (&t);
+    while (MipsStep (m, fastForward) == fastForward
+           && RunTimed (&t, m, warmup) == warmup) {
+        cycles = t.cycles;
+        done = RunTimed (&t, m, detail);
+        if (done > 0) {
+            cpi = (double) (t.cycles - cycles) / done;
+            sum += cpi;
+            sumSq += cpi * cpi;
+            n++;
+        }
+        if (done < detail) {
+            break;
+        }
+    }
+
+    printf ("Sampled simulation: %ld instructions, %d intervals of %ld measured\n",
+        MipsInstrCount (m), n, detail);
+    if (n == 0) {
+        printf ("  Program ended before the first interval\n");
+        return;
+    }
+    mean = sum / n;
+    if (n > 1) {
+        /* normal approximation, 95% */
+        halfWidth = 1.96 * sqrt ((sumSq - n * mean * mean) / (n - 1) / n);
+    }
+    printf ("  CPI %.4f +/- %.4f (95%% confidence)\n", mean, halfWidth);
+    printf ("  Estimated cycles %.0f +/- %.0f\n", mean * MipsInstrCount (m),
+        halfWidth * MipsInstrCount (m));
+}
+
+/*
+ *  Basic-block vectors, gathered by a step hook over the pc stream, and
+ *  the values read_int returned, one per line, for the timed pass to
+ *  read back
+ */
+typedef struct {
+    double (*bbv) [BBVDIM];
+    int numIntervals;
+    long interval, inInterval;
+    int leader, lastPc;
+    int v0;			/* $v0 before the instruction just simulated */
+    FILE *inputs;
+} Profile;
+
+static int ProfileStep (MipsSim *m, int pc, int changedReg, int changedMem,
+    void *arg) {
+    Profile *p = arg;
+    int instr;
+
+    if (p->v0 == 5 && MipsReadMem (m, pc, &instr) == 0
+        && (instr & 0xfc00003f) == 0x0000000c) {
+        fprintf (p->inputs, "%d\n", MipsGetReg (m, 2));
+    }
+    p->v0 = MipsGetReg (m, 2);
+
+    /* a block starts wherever control did not just fall through */
+    if (pc != p->lastPc + 4) {
+        p->leader = pc;
+    }
+    p->lastPc = pc;
+    p->bbv[p->numIntervals][((unsigned int) p->leader >> 2) % BBVDIM] += 1;
+    if (++p->inInterval == p->interval) {
+        p->inInterval = 0;
+        if (++p->numIntervals == MAXINTERVALS) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static double Distance (double *a, double *b) {
+    double d = 0;
+    int k;
+
+    for (k=0; k<BBVDIM; k++) {
+        d += (a[k] - b[k]) * (a[k] - b[k]);
+    }
+    return d;
+}
+
+/*
+ *  Cluster the n vectors into k with k-means, seeded with the first
+ *  vector and then each time the vector furthest from every seed so far.
+ *  Set cluster[i] for every vector and return the index of the vector
+ *  nearest each centroid in rep[].
+ */
+static void Cluster (double (*bbv) [BBVDIM], int n, int k, int *cluster, int *rep) {
+    double centroids [MAXCLUSTERS][BBVDIM], best, d;
+    int counts [MAXCLUSTERS];
+    int i, c, j, iter, changed;
+
+    memcpy (centroids[0], bbv[0], sizeof (centroids[0]));
+    for (c=1; c<k; c++) {
+        int far = 0;
+        double farthest = -1;
+        for (i=0; i<n; i++) {
+            for (j=0, best=INFINITY; j<c; j++) {
+                d = Distance (bbv[i], centroids[j]);
+                best = d < best ? d : best;
+            }
+            if (best > farthest) {
+                farthest = best;
+                far = i;
+            }
+        }
+        memcpy (centroids[c], bbv[far], sizeof (centroids[c]));
+    }
+
+    for (i=0; i<n; i++) {
+        cluster[i] = -1;
+    }
+    for (iter=0, changed=1; changed && iter<100; iter++) {
+        changed = 0;
+        for (i=0; i<n; i++) {
+            for (c=0, j=0, best=INFINITY; c<k; c++) {
+                d = Distance (bbv[i], centroids[c]);
+                if (d < best) {
+                    best = d;
+                    j = c;
+                }
+            }
+            changed |= cluster[i] != j;
+            cluster[i] = j;
+        }
+        memset (centroids, 0, sizeof (centroids));
+        memset (counts, 0, sizeof (counts));
+        for (i=0; i<n; i++) {
+            counts[cluster[i]]++;
+            for (j=0; j<BBVDIM; j++) {
+                centroids[cluster[i]][j] += bbv[i][j];
+            }
+        }
+        for (c=0; c<k; c++) {
+            for (j=0; j<BBVDIM && counts[c]>0; j++) {
+                centroids[c][j] /= counts[c];
+            }
+        }
+    }
+
+    for (c=0; c<k; c++) {
+        rep[c] = -1;
+        for (i=0, best=INFINITY; i<n; i++) {
+            if (cluster[i] == c && (d = Distance (bbv[i], centroids[c])) < best) {
+                best = d;
+                rep[c] = i;
+            }
+        }
+    }
+}
+
+static int CompareInts (const void *a, const void *b) {
+    return *(const int *) a - *(const int *) b;
+}
+
+/*
+ *  Profile the machine to collect a basic-block vector for each interval
+ *  of the run, pick k simulation points by clustering them, and time just
+ *  those intervals (after warmup instructions each) on a copy taken
+ *  before the profile.  At most MAXINTERVALS intervals are profiled, and
+ *  the machine is left where the profile stopped, so it ends as the run
+ *  did.  The profile's syscall output is thrown away.  Input is read by
+ *  the profile and recorded, and the timed copy reads the recording, so
+ *  both passes see the same values.
+ */
+void SampleSimPoints (MipsSim *m, long interval, int k, long warmup) {
+    MipsSim *copy = MipsClone (m);
+    FILE *devNull = fopen ("/dev/null", "w"), *in;
+    Profile p;
+    TimingModel t;
+    int cluster [MAXINTERVALS], rep [MAXCLUSTERS], size [MAXCLUSTERS];
+    int points [MAXCLUSTERS], i, c;
+    double cpi [MAXCLUSTERS], estimate = 0;
+    long total, start, cycles, done;
+    char *inputs;
+    size_t inputSize;
+
+    memset (&p, 0, sizeof (p));
+    p.bbv = calloc (MAXINTERVALS + 1, sizeof (*p.bbv));
+    p.inputs = open_memstream (&inputs, &inputSize);
+    if (copy == NULL || p.bbv == NULL || p.inputs == NULL) {
+        fprintf (stderr, "Out of memory for simulation points.\n");
+        exit (1);
+    }
+    p.interval = interval;
+    p.lastPc = -1;
+    p.v0 = MipsGetReg (m, 2);
+    MipsSetIO (m, NULL, devNull);
+    MipsSetStepHook (m, ProfileStep, &p);
+    MipsStep (m, LONG_MAX);
+    MipsSetStepHook (m, NULL, NULL);
+    MipsSetIO (m, NULL, NULL);
+    total = MipsInstrCount (m);
+    if (devNull != NULL) {
+        fclose (devNull);
+    }
+    fclose (p.inputs);
+    if (p.numIntervals == 0) {
+        printf ("Simulation points: program shorter than one interval\n");
+        MipsDestroy (copy);
+        free (inputs);
+        free (p.bbv);
+        return;
+    }
+
+    for (i=0; i<p.numIntervals; i++) {
+        for (c=0; c<BBVDIM; c++) {
+            p.bbv[i][c] /= interval;
+        }
+    }
+    k = k < p.numIntervals ? k : p.numIntervals;
+    Cluster (p.bbv, p.numIntervals, k, cluster, rep);
+    memset (size, 0, sizeof (size));
+    for (i=0; i<p.numIntervals; i++) {
+        size[cluster[i]]++;
+    }
+    /* a cluster can come out empty when intervals repeat exactly */
+    for (c=0, i=0; c<k; c++) {
+        if (rep[c] != -1) {
+            points[i++] = rep[c];
+        }
+    }
+    k = i;
+    qsort (points, k, sizeof (int), CompareInts);
+
+    /* Second pass: fast-forward to each point, warm up, and time it */
+    in = inputSize > 0 ? fmemopen (inputs, inputSize, "r")
+        : fopen ("/dev/null", "r");
+    if (in == NULL) {
+        fprintf (stderr, "Out of memory for simulation points.\n");
+        exit (1);
+    }
+    MipsSetIO (copy, in, NULL);
+    InitModel (&t);
+    for (c=0; c<k; c++) {
+        start = points[c] * interval;
+        if (start - warmup > MipsInstrCount (copy)) {
+            MipsStep (copy, start - warmup - MipsInstrCount (copy));
+        }
+        RunTimed (&t, copy, start - MipsInstrCount (copy));
+        cycles = t.cycles;
+        done = RunTimed (&t, copy, interval);
+        cpi[c] = done > 0 ? (double) (t.cycles - cycles) / done : 0;
+    }
+    MipsDestroy (copy);
+    fclose (in);
+    free (inputs);
+
+    printf ("Simulation points: %d of %d intervals of %ld, %ld instructions\n",
+        k, p.numIntervals, interval, total);
+    for (c=0; c<k; c++) {
+        i = cluster[points[c]];
+        printf ("  interval %d (instruction %ld)  weight %.3f  CPI %.4f\n",
+            points[c], points[c] * interval, (double) size[i] / p.numIntervals,
+            cpi[c]);
+        estimate += cpi[c] * size[i] / p.numIntervals;
+    }
+    printf ("  Estimated CPI %.4f\n", estimate);
+    printf ("  Estimated cycles %.0f\n", estimate * total);
+    free (p.bbv);
+}
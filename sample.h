@@ -0,0 +1,32 @@
+
+/*
+ *  Sampled simulation.  Most of a run goes through the functional engine
+ *  at full speed; only chosen intervals go through a timing model of a
+ *  simple in-order pipeline with instruction and data caches and a branch
+ *  predictor.  Cycles and CPI for the whole run are extrapolated from
+ *  those intervals.  Intervals are either periodic (with a confidence
+ *  interval from their spread), or simulation points: one representative
+ *  interval per cluster of basic-block vectors, weighted by cluster size.
+ */
+
+#define CACHELINES 64		/* lines in each direct-mapped cache */
+#define LINEBYTES 16		/* bytes in a cache line */
+#define MISSPENALTY 10		/* cycles added by a cache miss */
+#define PREDICTORSIZE 1024	/* 2-bit counters in the branch predictor */
+#define BRANCHPENALTY 2		/* cycles lost to a mispredicted branch */
+#define JUMPPENALTY 1		/* cycles lost to j, jal and jr */
+#define LOADUSEPENALTY 1	/* stall when an instruction needs a load's result */
+
+#define BBVDIM 32		/* dimensions basic-block vectors are hashed into */
+#define MAXINTERVALS 4096	/* intervals of a run that simpoints can cluster */
+#define MAXCLUSTERS 16
+
+typedef struct {
+    unsigned int icache [CACHELINES], dcache [CACHELINES];	/* tag, or 0 */
+    unsigned char counters [PREDICTORSIZE];
+    int loadDest;		/* register the previous instruction loaded, or -1 */
+    long cycles;
+} TimingModel;
+
+void SamplePeriodic (MipsSim *m, long period, long warmup, long detail);
+void SampleSimPoints (MipsSim *m, long interval, int k, long warmup);
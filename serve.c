@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "computer.h"
+#include "decode.h"
+#include "metrics.h"
+#include "mipssim.h"
+#include "serve.h"
+
+#define MAXJOBINPUT 65536	/* bytes of syscall input a job may send */
+
+typedef struct {
+    pthread_t thread;
+    int listenFd;
+    MipsSim *machine;
+    long kinds [NUMKINDS];	/* instructions of the current job, by kind */
+} Worker;
+
+static void Reply (Worker *w, FILE *out, char *options, long wallUs,
+    char *output, size_t outputSize) {
+    MipsSim *m = w->machine;
+    const int *memory = MipsMemory (m);
+    int k, nonzero;
+    unsigned int sum = DataChecksum (memory, &nonzero);
+
+    fprintf (out, "EXIT %s %ld %8.8x\n", exitReasonNames[MipsExitReason (m)],
+        MipsInstrCount (m), MipsGetPc (m));
+    if (strstr (options, "regs") != NULL) {
+        fprintf (out, "REGS");
+        for (k=0; k<32; k++) {
+            fprintf (out, " %8.8x", MipsGetReg (m, k));
+        }
+        fprintf (out, "\n");
+    }
+    if (strstr (options, "mem") != NULL) {
+        for (k=MAXNUMINSTRS; k<IMAGEWORDS; k++) {
+            if (memory[k] != 0) {
+                fprintf (out, "MEM %8.8x %8.8x\n", 0x00400000+4*k, memory[k]);
+            }
+        }
+    }
+    fprintf (out, "OUTPUT %lu\n", (unsigned long) outputSize);
+    fwrite (output, 1, outputSize, out);
+    fprintf (out, "METRICS {\"instructions\": %ld, \"exitReason\": \"%s\", "
+        "\"pc\": %u, \"opcodes\": {", MipsInstrCount (m),
+        exitReasonNames[MipsExitReason (m)], (unsigned int) MipsGetPc (m));
+    for (k=0; k<NUMKINDS; k++) {
+        fprintf (out, "%s\"%s\": %ld", k ? ", " : "", kindNames[k], w->kinds[k]);
+    }
+    fprintf (out, "}, \"memory\": {\"nonzeroWords\": %d, \"checksum\": %u}, "
+        "\"wallSeconds\": %.6f}\n", nonzero, sum, wallUs / 1e6);
+    fprintf (out, "END\n");
+}
+
+/* Read, run and answer the job whose header line has just been read. */
+static void Job (Worker *w, FILE *in, FILE *out, char *header) {
+    static const char empty[1] = "";
+    unsigned char program [4*MAXNUMINSTRS];
+    char options [64] = "", *input, *output;
+    size_t outputSize;
+    long length, limit, inputLength, done;
+    struct timespec start, end;
+    FILE *jobIn, *jobOut;
+
+    if (sscanf (header, "RUN %ld %ld %ld %63[^\n]", &length, &limit,
+            &inputLength, options) < 3) {
+        fprintf (out, "ERROR bad RUN line\n");
+        return;
+    }
+    if (length < 0 || length > sizeof (program)
+        || inputLength < 0 || inputLength > MAXJOBINPUT) {
+        fprintf (out, "ERROR program or input too big\n");
+        return;
+    }
+    input = malloc (inputLength + 1);
+    if (input == NULL || fread (program, 1, length, in) != length
+        || fread (input, 1, inputLength, in) != inputLength) {
+        free (input);
+        fprintf (out, "ERROR short job\n");
+        return;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    if (MipsLoadBuffer (w->machine, program, length) != MIPS_OK) {
+        free (input);
+        fprintf (out, "ERROR program can't be loaded\n");
+        return;
+    }
+    memset (w->kinds, 0, sizeof (w->kinds));
+    /* fmemopen will not take an empty buffer; an empty string reads the same */
+    jobIn = inputLength > 0 ? fmemopen (input, inputLength, "r")
+        : fmemopen ((void *) empty, 1, "r");
+    jobOut = open_memstream (&output, &outputSize);
+    MipsSetIO (w->machine, jobIn, jobOut);
+    if (limit <= 0) {
+        limit = SERVELIMIT;
+    }
+    while (MipsInstrCount (w->machine) < limit) {
+        done = limit - MipsInstrCount (w->machine);
+        done = MipsStep (w->machine, done < PROGRESSINTERVAL ? done : PROGRESSINTERVAL);
+        if (MipsExitReason (w->machine) != EXIT_RUNNING) {
+            break;
+        }
+        if (MipsInstrCount (w->machine) < limit) {
+            fprintf (out, "PROGRESS %ld\n", MipsInstrCount (w->machine));
+            fflush (out);
+        }
+    }
+    MipsSetIO (w->machine, NULL, NULL);
+    fclose (jobIn);
+    fclose (jobOut);
+    clock_gettime (CLOCK_MONOTONIC, &end);
+
+    Reply (w, out, options, (end.tv_sec - start.tv_sec) * 1000000L
+        + (end.tv_nsec - start.tv_nsec) / 1000, output, outputSize);
+    free (output);
+    free (input);
+}
+
+/* Serve one connection after another on this worker's machine. */
+static void *RunWorker (void *arg) {
+    Worker *w = arg;
+    char line [128];
+    FILE *in, *out;
+    int fd;
+
+    while (1) {
+        fd = accept (w->listenFd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        in = fdopen (fd, "r");
+        out = fdopen (dup (fd), "w");
+        while (fgets (line, sizeof (line), in) != NULL) {
+            if (strncmp (line, "RUN ", 4) == 0) {
+                Job (w, in, out, line);
+            } else {
+                fprintf (out, "ERROR unknown request\n");
+            }
+            fflush (out);
+        }
+        fclose (out);
+        fclose (in);
+    }
+    return NULL;
+}
+
+/*
+ *  Listen on the socket at path and serve jobs until killed, with
+ *  poolSize machines.
+ */
+void Serve (char *path, int poolSize) {
+    struct sockaddr_un addr;
+    Worker *workers;
+    int fd, k;
+
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    if (fd < 0 || strlen (path) >= sizeof (addr.sun_path)) {
+        fprintf (stderr, "Can't serve on %s.\n", path);
+        exit (1);
+    }
+    strcpy (addr.sun_path, path);
+    unlink (path);
+    if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0
+        || listen (fd, 64) != 0) {
+        fprintf (stderr, "Can't serve on %s.\n", path);
+        exit (1);
+    }
+    /* a client that goes away mid-reply is not the server's problem */
+    signal (SIGPIPE, SIG_IGN);
+
+    workers = calloc (poolSize, sizeof (Worker));
+    if (workers == NULL) {
+        fprintf (stderr, "Out of memory for the machine pool.\n");
+        exit (1);
+    }
+    for (k=0; k<poolSize; k++) {
+        workers[k].listenFd = fd;
+        workers[k].machine = MipsCreate ();
+        if (workers[k].machine == NULL) {
+            fprintf (stderr, "Out of memory for the machine pool.\n");
+            exit (1);
+        }
+        /* touch every page of the machine now rather than in the first job */
+        MipsLoadBuffer (workers[k].machine, "", 0);
+        MipsCountKinds (workers[k].machine, workers[k].kinds);
+        if (pthread_create (&workers[k].thread, NULL, RunWorker, &workers[k]) != 0) {
+            fprintf (stderr, "Can't start server thread %d.\n", k);
+            exit (1);
+        }
+    }
+    fprintf (stderr, "Serving on %s with %d machines.\n", path, poolSize);
+    for (k=0; k<poolSize; k++) {
+        pthread_join (workers[k].thread, NULL);
+    }
+}
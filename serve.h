@@ -0,0 +1,29 @@
+
+/*
+ *  Simulation server.  Listens on a Unix domain socket and runs the jobs
+ *  sent to it on a fixed pool of machines that are created once, up front,
+ *  so a job costs no process start and no allocation.  Each connection is
+ *  served by one machine and may send any number of jobs, one after the
+ *  other.  A job is the header line
+ *
+ *      RUN <program bytes> <instruction limit> <input bytes> [regs] [mem]
+ *
+ *  followed by the program (a dump file) and then the text syscalls read
+ *  from.  A limit of 0 means SERVELIMIT.  The reply is made of lines:
+ *
+ *      PROGRESS <instructions>		every PROGRESSINTERVAL instructions
+ *      EXIT <reason> <instructions> <pc>
+ *      REGS <r0> .. <r31>		if regs was asked for
+ *      MEM <address> <value>		each nonzero data word, if mem was
+ *      OUTPUT <bytes>			followed by what syscalls printed
+ *      METRICS <json>
+ *      END
+ *
+ *  or a single ERROR <message> line if the job could not be run.
+ */
+
+#define SERVEPOOL 4		/* machines, and connections served at once */
+#define SERVELIMIT 100000000L	/* instructions a job may run by default */
+#define PROGRESSINTERVAL 1048576	/* instructions between PROGRESS lines */
+
+void Serve (char *path, int poolSize);
@@ -1,24 +1,210 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include "computer.h"
+#include "undo.h"
+#include "input.h"
+#include "harts.h"
+#include "decode.h"
+#include "metrics.h"
+#include "filter.h"
+#include "tracebuf.h"
+#include "lockstep.h"
+#include "mipssim.h"
+#include "engine.h"
+#include "serve.h"
+#include "elf.h"
+#include "sample.h"
+#include "plugin.h"
+#include "lanes.h"
+#include "os.h"
+#include "ilp.h"
+#include "memprof.h"
+#include "chunktrace.h"
+#include "hostperf.h"
+#include "gdbstub.h"
 
 #define TRUE 1
 #define FALSE 0
 
+#undef mips			/* gcc already has a def for mips */
+extern Computer mips;
+
+/* Step hook counting into the metrics, as Simulate does, for plugin runs */
+static int CountStep (MipsSim *m, int pc, int changedReg, int changedMem,
+    void *arg) {
+    int instr;
+
+    if (MipsReadMem (m, pc, &instr) == 0) {
+        CountInstr (KindOf ((instr >> 26) & 0x3f, instr & 0x3f),
+            MipsGetPc (m) != pc + 4);
+    }
+    return 0;
+}
+
+/* Take the results of a run of the functional engine, for the report. */
+static void FromMachine (MipsSim *machine) {
+    int k;
+
+    mips.exitReason = MipsExitReason (machine);
+    mips.instrCount = MipsInstrCount (machine);
+    mips.pc = MipsGetPc (machine);
+    for (k=0; k<32; k++) {
+        mips.registers[k] = MipsGetReg (machine, k);
+    }
+    memcpy (mips.memory, MipsMemory (machine), sizeof (mips.memory));
+}
+
 int main (int argc, char *argv[]) {
     int argIndex;
     int printingRegisters = FALSE;
     int printingMemory = FALSE;
     int debugging = FALSE;
     int interactive = FALSE;
-    FILE *filein;
+    int undo = FALSE;
+    int numHarts = 0, parallel = FALSE;
+    long quantum = 1;
+    char *metricsFile = NULL;
+    long lockstep = 0;
+    unsigned int seed = 0;
+    int randomRuns = 0;
+    char *servePath = NULL;
+    int poolSize = SERVEPOOL;
+    MipsSim *machine;
+    int filterArgs [32], numFilterArgs = 0, k;
+    long period = 0, warmup = 0, detail = 0, interval = 0;
+    int numPoints = 0;
+    long maxInstr = 0;
+    double timeout = 0;
+    int textOnly = FALSE;
+    int numPlugins = 0;
+    char *sweepPath = NULL;
+    long osQuantum = 0;
+    int windows [MAXWINDOWS], numWindows = -1;
+    char *window;
+    char *memprofPath = NULL;
+    char *chunkTracePath = NULL;
+    int tracePolicy = TRACE_SYNC;
+    char *dataPath = NULL;
+    int hostPerf = FALSE;
+    const char *engine;
+    char *gdbWhere = NULL;
 
     if (argc < 2) {
-        fprintf (stderr, "Not enough arguments.\n");
+        fprintf (stderr, "Not enough arguments.\n"
+            "Usage: sim [-r] [-m] [-i] [-d] [-u] [-s] [-t] [--option value ...] program\n"
+            "Exit status: 0 when the program ends, by the exit syscall, an\n"
+            "unsupported instruction (how the sample programs end) or q alike;\n"
+            "1 for an error; 2 at the instruction limit; 3 when the pc leaves\n"
+            "memory; 4 on a self loop; 5 on timeout.\n");
         exit (1);
     }
+    InitTraceFilter ();
     for (argIndex=1; argIndex<argc && argv[argIndex][0]=='-'; argIndex++) {
-        /* Argument is an option, we hope one of -r, -m, -i, -d. */
+        /*
+         * Long options take the next argument as their value, except the
+         * flags --hostperf and --no-superops.
+         */
+        if (argv[argIndex][1] == '-') {
+            if (strcmp (argv[argIndex], "--hostperf") == 0) {
+                hostPerf = TRUE;
+            } else if (strcmp (argv[argIndex], "--no-superops") == 0) {
+                fusing = 0;
+            } else if (argIndex+1 == argc) {
+                fprintf (stderr, "Option \"%s\" needs a value.\n", argv[argIndex]);
+                exit (1);
+            } else if (strcmp (argv[argIndex], "--record") == 0) {
+                RecordInput (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--replay") == 0) {
+                ReplayInput (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--harts") == 0) {
+                numHarts = atoi (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--hart-mode") == 0) {
+                parallel = strcmp (argv[++argIndex], "parallel") == 0;
+            } else if (strcmp (argv[argIndex], "--quantum") == 0) {
+                quantum = atol (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--metrics") == 0) {
+                metricsFile = argv[++argIndex];
+            } else if (strcmp (argv[argIndex], "--lockstep") == 0) {
+                lockstep = atol (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--lockstep-random") == 0) {
+                if (sscanf (argv[++argIndex], "%u:%d", &seed, &randomRuns) != 2) {
+                    fprintf (stderr, "--lockstep-random takes SEED:COUNT.\n");
+                    exit (1);
+                }
+            } else if (strcmp (argv[argIndex], "--serve") == 0) {
+                servePath = argv[++argIndex];
+            } else if (strcmp (argv[argIndex], "--pool") == 0) {
+                poolSize = atoi (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--max-instr") == 0) {
+                maxInstr = atol (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--timeout") == 0) {
+                timeout = atof (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--sample") == 0) {
+                if (sscanf (argv[++argIndex], "%ld:%ld:%ld", &period, &warmup, &detail) != 3
+                    || detail <= 0 || warmup < 0 || warmup + detail > period) {
+                    fprintf (stderr, "--sample takes PERIOD:WARMUP:DETAIL.\n");
+                    exit (1);
+                }
+            } else if (strcmp (argv[argIndex], "--simpoints") == 0) {
+                if (sscanf (argv[++argIndex], "%ld:%d:%ld", &interval, &numPoints, &warmup) < 2
+                    || interval <= 0 || numPoints <= 0 || numPoints > MAXCLUSTERS) {
+                    fprintf (stderr, "--simpoints takes INTERVAL:K[:WARMUP], K at most %d.\n",
+                        MAXCLUSTERS);
+                    exit (1);
+                }
+            } else if (strcmp (argv[argIndex], "--ilp") == 0) {
+                numWindows = 0;
+                for (window = strtok (argv[++argIndex], ","); window != NULL;
+                     window = strtok (NULL, ",")) {
+                    if (numWindows == MAXWINDOWS || atoi (window) < 1
+                        || atoi (window) > MAXWINDOW) {
+                        fprintf (stderr, "--ilp takes up to %d window sizes "
+                            "from 1 to %d, separated by commas.\n", MAXWINDOWS,
+                            MAXWINDOW);
+                        exit (1);
+                    }
+                    windows[numWindows++] = atoi (window);
+                }
+            } else if (strcmp (argv[argIndex], "--trace-writer") == 0) {
+                argIndex++;
+                if (strcmp (argv[argIndex], "block") == 0) {
+                    tracePolicy = TRACE_BLOCK;
+                } else if (strcmp (argv[argIndex], "drop") == 0) {
+                    tracePolicy = TRACE_DROP;
+                } else {
+                    fprintf (stderr, "--trace-writer takes block or drop.\n");
+                    exit (1);
+                }
+            } else if (strcmp (argv[argIndex], "--gdb") == 0) {
+                gdbWhere = argv[++argIndex];
+            } else if (strcmp (argv[argIndex], "--data") == 0) {
+                dataPath = argv[++argIndex];
+            } else if (strcmp (argv[argIndex], "--chunk-trace") == 0) {
+                chunkTracePath = argv[++argIndex];
+            } else if (strcmp (argv[argIndex], "--memprof") == 0) {
+                memprofPath = argv[++argIndex];
+            } else if (strcmp (argv[argIndex], "--os") == 0) {
+                osQuantum = atol (argv[++argIndex]);
+            } else if (strcmp (argv[argIndex], "--sweep") == 0) {
+                sweepPath = argv[++argIndex];
+            } else if (strcmp (argv[argIndex], "--plugin") == 0) {
+                if (LoadPlugin (argv[++argIndex]) != 0) {
+                    exit (1);
+                }
+                numPlugins++;
+            } else if (strncmp (argv[argIndex], "--trace-", 8) == 0
+                       && numFilterArgs < 32) {
+                /* set once the program is loaded, as it may name symbols */
+                filterArgs[numFilterArgs++] = argIndex++;
+            } else {
+                fprintf (stderr, "Invalid option \"%s\".\n", argv[argIndex]);
+                exit (1);
+            }
+            continue;
+        }
+        /* Argument is an option, we hope one of -r, -m, -i, -d, -u, -s, -t. */
         switch (argv[argIndex][1]) {
             case 'r':
             printingRegisters = TRUE;
@@ -32,28 +218,166 @@ int main (int argc, char *argv[]) {
             case 'd':
             debugging = TRUE;
             break;
+            case 'u':
+            undo = TRUE;
+            break;
+            case 's':
+            silent = TRUE;
+            break;
+            case 't':
+            textOnly = TRUE;
+            break;
             default:
             fprintf (stderr, "Invalid option \"%s\".\n", argv[argIndex]);
-            fprintf (stderr, "Correct options are -r, -m, -i, -d.\n");
+            fprintf (stderr, "Correct options are -r, -m, -i, -d, -u, -s, -t.\n");
             exit (1);
         }
     }
+    if (metricsFile != NULL && numHarts > 0) {
+        /* one report has room for one machine's registers */
+        fprintf (stderr, "--metrics can't be used with --harts.\n");
+        exit (1);
+    }
+    if ((chunkTracePath != NULL || memprofPath != NULL)
+        && (gdbWhere != NULL || period > 0 || interval > 0 || numWindows >= 0
+            || lockstep > 0 || randomRuns > 0 || sweepPath != NULL || numHarts > 0
+            || numPlugins > 0 || osQuantum > 0 || servePath != NULL)) {
+        /* only Simulate records instructions for them */
+        fprintf (stderr, "--chunk-trace and --memprof need the staged engine.\n");
+        exit (1);
+    }
+    if (servePath != NULL) {
+        /* jobs bring their own programs */
+        Serve (servePath, poolSize > 0 ? poolSize : 1);
+        return 0;
+    }
+    /* from here on every engine checks it, see CheckLimits */
+    if (timeout > 0) {
+        StartTimeout (timeout);
+    }
+    if (randomRuns > 0) {
+        /* generated programs, no file to load */
+        InitTrace ();
+        return LockstepRandom (seed, randomRuns, lockstep > 0 ? lockstep : 1);
+    }
     if (argIndex == argc) {
         fprintf (stderr, "No file name given.\n");
         exit (1);
+    } else if (osQuantum > 0) {
+        /* every file named is a process */
+        return RunProcesses (argv+argIndex, argc-argIndex, osQuantum, maxInstr,
+            printingRegisters);
     } else if (argIndex < argc-1) {
         fprintf (stderr, "Too many arguments.\n");
         exit (1);
     }
     
-    filein = fopen (argv[argIndex], "r");
-    if (filein == NULL) {
+    machine = MipsCreate ();
+    switch (MipsLoadFile (machine, argv[argIndex])) {
+    case MIPS_NOFILE:
         fprintf (stderr, "Can't open file: %s\n", argv[argIndex]);
         exit (1);
+    case MIPS_TOOBIG:
+        fprintf (stderr, "Program too big.\n");
+        exit (1);
+    case MIPS_BADELF:
+        fprintf (stderr, "Can't load %s: %s.\n", argv[argIndex],
+            MipsLoadError (machine));
+        exit (1);
     }
-    
-    InitComputer (filein, printingRegisters, printingMemory,
+    if (dataPath != NULL) {
+        switch (MipsLoadData (machine, dataPath)) {
+        case MIPS_NOFILE:
+            fprintf (stderr, "Can't open file: %s\n", dataPath);
+            exit (1);
+        case MIPS_TOOBIG:
+            fprintf (stderr, "Data too big.\n");
+            exit (1);
+        }
+    }
+    MipsInstall (machine, printingRegisters, printingMemory,
 	debugging, interactive);
-    Simulate ();
-    return 0;
+    for (k=0; k<numFilterArgs; k++) {
+        if (!SetTraceFilter (argv[filterArgs[k]], argv[filterArgs[k]+1])) {
+            fprintf (stderr, "Invalid option \"%s\".\n", argv[filterArgs[k]]);
+            exit (1);
+        }
+    }
+    mips.maxInstr = maxInstr;
+    MipsSetMaxInstr (machine, maxInstr);
+    mips.textOnly = textOnly;
+    if (undo) {
+        InitUndo ();
+    }
+    InitTrace ();
+    if (tracePolicy != TRACE_SYNC) {
+        StartTraceWriter (tracePolicy);
+    }
+    StartMetrics ();
+    profiling = metricsFile != NULL || memprofPath != NULL
+        || chunkTracePath != NULL;
+    if (memprofPath != NULL) {
+        StartMemProfile ();
+    }
+    if (chunkTracePath != NULL) {
+        StartChunkTrace (chunkTracePath);
+    }
+    if (hostPerf) {
+        StartHostCounters ();
+    }
+    if (gdbWhere != NULL) {
+        /* the debugger drives the functional engine */
+        engine = "gdb";
+        ServeGdb (machine, gdbWhere);
+        FromMachine (machine);
+    } else if (period > 0) {
+        engine = "sampled";
+        SamplePeriodic (machine, period, warmup, detail);
+        FromMachine (machine);
+    } else if (interval > 0) {
+        engine = "simpoints";
+        SampleSimPoints (machine, interval, numPoints, warmup);
+        FromMachine (machine);
+    } else if (numWindows >= 0) {
+        engine = "ilp";
+        AnalyzeIlp (machine, windows, numWindows, maxInstr);
+        FromMachine (machine);
+    } else if (lockstep > 0) {
+        k = Lockstep (lockstep, maxInstr);
+        ReportHostCounters ("lockstep", mips.instrCount);
+        return k;
+    } else if (sweepPath != NULL) {
+        k = Sweep (sweepPath);
+        ReportHostCounters ("lanes", 0);
+        return k;
+    } else if (numHarts > 0) {
+        RunHarts (numHarts, parallel, quantum > 0 ? quantum : 1);
+        engine = "harts";
+    } else if (numPlugins > 0) {
+        /* plugins hook the functional engine, not the staged pipeline */
+        engine = "functional+plugins";
+        if (metricsFile != NULL) {
+            MipsSetStepHook (machine, CountStep, NULL);
+        }
+        MipsStep (machine, LONG_MAX);
+        FromMachine (machine);
+    } else {
+        engine = SimulateModeName ();
+        Simulate ();
+    }
+    FinishPlugins ();
+    TraceFlush ();
+    FinishChunkTrace ();
+    ReportHostCounters (engine, mips.instrCount);
+    if (metricsFile != NULL) {
+        WriteMetrics (metricsFile);
+    }
+    if (memprofPath != NULL) {
+        WriteMemProfile (memprofPath);
+    }
+    if (exitStatus[mips.exitReason] != 0) {
+        fprintf (stderr, "Stopped after %ld instructions, pc = %8.8x: %s.\n",
+            mips.instrCount, mips.pc, exitReasonNames[mips.exitReason]);
+    }
+    return exitStatus[mips.exitReason];
 }
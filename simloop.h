@@ -0,0 +1,181 @@
+
+/*
+ *  Step and the Simulate loop, included by computer.c once for each
+ *  combination of the SIM_ features with MODE defined to it.  MODE is a
+ *  constant, so a feature left out of it costs no flag test and brings
+ *  no tracing or command code into its variant; a feature in it is
+ *  still switched by its flag at run time.  The variant with every
+ *  feature is Step itself, for the callers outside Simulate.
+ */
+
+#define VARIANT2(name, mode) name##mode
+#define VARIANT(name, mode) VARIANT2 (name, mode)
+
+/*
+ *  Simulate the instruction at mips.pc, printing the trace for it unless
+ *  tracing is silenced or filtered out.  Return 0 without changing
+ *  anything if it is an unsupported instruction or the pc is out of
+ *  range, otherwise 1.
+ */
+#if MODE == SIM_ALL
+int Step (int *changedReg, int *changedMem) {
+#else
+static int VARIANT (StepMode, MODE) (int *changedReg, int *changedMem) {
+#endif
+    unsigned int instr;
+    int val, pc = mips.pc;
+    DecodedInstr d;
+
+    /* Running off the end of memory, or out of the code when asked */
+    if ((unsigned int) (mips.pc - 0x00400000) >= (MAXNUMINSTRS+MAXNUMDATA)*4
+        || (mips.pc & 3) != 0
+        || (mips.textOnly && (mips.pc < mips.textLo || mips.pc >= mips.textHi))) {
+        mips.exitReason = EXIT_PCRANGE;
+        return 0;
+    }
+
+    if (MODE & SIM_TRACE) {
+        mips.tracing = !silent
+            && (!filtering || TraceWanted (mips.pc, mips.instrCount + 1));
+    }
+
+    /* Fetch instr at mips.pc, returning it in instr */
+    instr = Fetch (mips.pc);
+
+    /*if(instr == 0x00000000){
+       exit(0);
+    }*/
+    if ((MODE & SIM_TRACE) && mips.tracing) {
+        const char *label = mips.program != NULL
+            ? SymbolAt (mips.program, mips.pc) : NULL;
+        if (label != NULL) {
+            TraceStr (label);
+            TraceStr (":\n");
+        }
+        TraceStr ("Executing instruction at ");
+        TraceHex (mips.pc);
+        TraceStr (": ");
+        TraceHex (instr);
+        TraceChar ('\n');
+    }
+
+    /*
+     * Decode instr, putting decoded instr in d
+     * Note that we reuse the d struct for each instruction.
+     */
+    Decode (instr, &d, &rVals);
+    if (d.type == NONE) {
+        mips.exitReason = EXIT_UNSUPPORTED;
+        return 0;
+    }
+
+    /*Print decoded instruction*/
+    if ((MODE & SIM_TRACE) && mips.tracing) {
+        PrintInstruction(&d);
+    }
+    if (d.type == R && d.regs.r.funct == 0x0c && mips.registers[2] == 10) {
+        /* syscall exit */
+        mips.exitReason = EXIT_SYSCALL;
+        return 0;
+    }
+    if ((MODE & SIM_UNDO) && undoLogging) {
+        UndoBegin ();
+    }
+
+    /*
+     * Perform computation needed to execute d, returning computed value
+     * in val
+     */
+    val = Execute(&d, &rVals);
+
+    UpdatePC(&d,val);
+
+    /*
+     * Perform memory load or store. Place the
+     * address of any updated memory in *changedMem,
+     * otherwise put -1 in *changedMem.
+     * Return any memory value that is read, otherwise return -1.
+     */
+    if ((MODE & SIM_UNDO) && undoLogging) {
+        UndoBeforeMem (&d, val);
+    }
+    if ((MODE & SIM_PROFILE) && profilingMemory
+        && (d.op == 0x23 || d.op == 0x2b || d.op == 0x30 || d.op == 0x38)) {
+        ProfileAccess (pc, val, d.op == 0x2b || d.op == 0x38, mips.instrCount);
+    }
+    val = Mem(&d, val, changedMem);
+
+    /*
+     * Write back to register. If the instruction modified a register--
+     * (including jal, which modifies $ra) --
+     * put the index of the modified register in *changedReg,
+     * otherwise put -1 in *changedReg.
+     */
+    RegWrite(&d, val, changedReg);
+
+    mips.instrCount++;
+    if (MODE & SIM_PROFILE) {
+        CountInstr (KindOf (d.op, d.regs.r.funct), mips.pc != pc + 4);
+        if (recordingTrace) {
+            RecordStep (pc, *changedReg, *changedMem);
+        }
+    }
+    if ((MODE & SIM_UNDO) && undoLogging) {
+        UndoCommit (*changedReg, *changedMem);
+    }
+    if ((MODE & SIM_TRACE) && mips.tracing) {
+        PrintInfo (*changedReg, *changedMem);
+    }
+    return 1;
+}
+
+/*
+ *  Run the simulation.
+ */
+static void VARIANT (SimulateMode, MODE) (void) {
+    char s[40];  /* used for handling interactive input */
+    int changedReg=-1, changedMem=-1;
+    int continuing = false;
+    int pc;
+
+    if (!(MODE & SIM_TRACE)) {
+        mips.tracing = false;
+    }
+    if ((MODE & SIM_UNDO) && undoLogging) {
+        UndoReset ();
+    }
+    while (1) {
+        if ((MODE & SIM_INTERACT) && mips.interactive && !continuing) {
+            TraceStr ("> ");
+            TraceFlush ();
+            ReadInput (s,sizeof(s));
+            if (s[0] == 'q') {
+                mips.exitReason = EXIT_QUIT;
+                return;
+            }
+            if (Command (s, &continuing)) {
+                continue;
+            }
+        }
+
+        pc = mips.pc;
+#if MODE == SIM_ALL
+        if (!Step (&changedReg, &changedMem)) {
+#else
+        if (!VARIANT (StepMode, MODE) (&changedReg, &changedMem)) {
+#endif
+            /* unsupported instruction, terminate */
+            return;
+        }
+        if (Runaway (pc, changedReg, changedMem)) {
+            return;
+        }
+        if ((MODE & SIM_INTERACT) && continuing && IsBreakpoint (mips.pc)) {
+            continuing = false;
+        }
+    }
+}
+
+#undef VARIANT2
+#undef VARIANT
+#undef MODE
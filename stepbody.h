@@ -0,0 +1,168 @@
+
+/*
+ *  Body of StepHart, included by engine.c once per combination of plugin
+ *  events with HI and LO defined to the two octal digits of the event
+ *  mask.  HOOKS is then a constant, so the compiler drops the call for
+ *  every event outside it; the variant for mask 0 is StepHart itself.
+ */
+
+#define HOOKS (HI*8 + LO)
+#define VARIANT2(hi, lo) StepHooked##hi##lo
+#define VARIANT(hi, lo) VARIANT2 (hi, lo)
+
+#if HI == 0 && LO == 0
+int StepHart (Hart *h, int *memory, DecodedImage *img,
+    int *changedReg, int *changedMem) {
+#else
+static int VARIANT (HI, LO) (Hart *h, int *memory, DecodedImage *img,
+    int *changedReg, int *changedMem) {
+#endif
+    int *r = h->registers;
+    int k = INDEX (h->pc);
+    int rs, rt, rd, immed, addr, next;
+
+    if (!INRANGE (k)) {
+        return 0;
+    }
+    if (HOOKS & HOOK_FETCH) {
+        HookFetch (h->pc, Load (memory, k));
+    }
+    if (HOOKS & HOOK_DECODE) {
+        HookDecode (h->pc, KindOf (img->op[k], img->funct[k]));
+    }
+    rs = img->rs[k];
+    rt = img->rt[k];
+    rd = img->rd[k];
+    immed = img->immed[k];
+    next = h->pc + 4;
+    *changedReg = -1;
+    *changedMem = -1;
+
+    switch (img->op[k]) {
+    case 0x00:
+        switch (img->funct[k]) {
+        case 0x21: r[rd] = r[rs] + r[rt]; *changedReg = rd; break;
+        case 0x24: r[rd] = r[rs] & r[rt]; *changedReg = rd; break;
+        case 0x25: r[rd] = r[rs] | r[rt]; *changedReg = rd; break;
+        case 0x23: r[rd] = r[rs] - r[rt]; *changedReg = rd; break;
+        /* the staged Execute never computes slt, it writes 0 */
+        case 0x2a: r[rd] = 0; *changedReg = rd; break;
+        /* and shifts by the value in rt, not by shamt */
+        case 0x00: r[rd] = r[rs] << r[rt]; *changedReg = rd; break;
+        case 0x02: r[rd] = r[rs] >> r[rt]; *changedReg = rd; break;
+        case 0x08:
+            next = r[31];
+            if (HOOKS & HOOK_BRANCH) {
+                HookBranch (h->pc, next, 1);
+            }
+            break;
+        case 0x0c:
+            if (r[2] == 10) {
+                return 0;
+            }
+            if (r[2] == 5) {
+                *changedReg = 2;
+            }
+            r[2] = HartSyscall (h, memory);
+            break;
+        default:
+            return 0;
+        }
+        break;
+    /* addiu and andi read rt rather than rs in the staged Execute */
+    case 0x09: r[rt] = r[rt] + StagedImmed (immed); *changedReg = rt; break;
+    case 0x0c: r[rt] = r[rt] & StagedImmed (immed); *changedReg = rt; break;
+    case 0x0d: r[rt] = r[rs] | StagedImmed (immed); *changedReg = rt; break;
+    case 0x0f: r[rt] = StagedImmed (immed) << 16; *changedReg = rt; break;
+    case 0x04:
+        if (r[rs] == r[rt]) {
+            next = h->pc + 4 + (immed << 2);
+        }
+        if (HOOKS & HOOK_BRANCH) {
+            HookBranch (h->pc, h->pc + 4 + (immed << 2), r[rs] == r[rt]);
+        }
+        break;
+    case 0x05:
+        /* a taken bne lands one word past its target in UpdatePC */
+        if (r[rs] != r[rt]) {
+            next = h->pc + 8 + (immed << 2);
+        }
+        if (HOOKS & HOOK_BRANCH) {
+            HookBranch (h->pc, h->pc + 8 + (immed << 2), r[rs] != r[rt]);
+        }
+        break;
+    case 0x23:
+        addr = r[rs] + immed;
+        r[rt] = Load (memory, INDEX (addr));
+        *changedReg = rt;
+        if (HOOKS & HOOK_MEMREAD) {
+            HookMemRead (h->pc, addr, r[rt]);
+        }
+        break;
+    case 0x2b:
+        addr = r[rs] + immed;
+        if (INIMAGE (addr)) {
+            Store (memory, img, INDEX (addr), r[rt]);
+            *changedMem = addr;
+            if (HOOKS & HOOK_MEMWRITE) {
+                HookMemWrite (h->pc, addr, r[rt]);
+            }
+        }
+        break;
+    case 0x30:
+        /* ll: reserve the word; sc below succeeds only if it is unchanged */
+        addr = r[rs] + immed;
+        h->link = INDEX (addr);
+        h->linkVal = Load (memory, h->link);
+        r[rt] = h->linkVal;
+        *changedReg = rt;
+        if (HOOKS & HOOK_MEMREAD) {
+            HookMemRead (h->pc, addr, r[rt]);
+        }
+        break;
+    case 0x38:
+        addr = r[rs] + immed;
+        k = INDEX (addr);
+        if (INRANGE (k) && k == h->link
+            && __atomic_compare_exchange_n (&memory[k], &h->linkVal, r[rt],
+                0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            DecodeStored (r[rt], k, 0x00400000, img);
+            *changedMem = addr;
+            if (HOOKS & HOOK_MEMWRITE) {
+                HookMemWrite (h->pc, addr, r[rt]);
+            }
+            r[rt] = 1;
+        } else {
+            r[rt] = 0;
+        }
+        h->link = -1;
+        *changedReg = rt;
+        break;
+    case 0x02:
+        next = img->target[k];
+        if (HOOKS & HOOK_BRANCH) {
+            HookBranch (h->pc, next, 1);
+        }
+        break;
+    case 0x03:
+        r[31] = h->pc + 4;
+        *changedReg = 31;
+        next = img->target[k];
+        if (HOOKS & HOOK_BRANCH) {
+            HookBranch (h->pc, next, 1);
+        }
+        break;
+    default:
+        return 0;
+    }
+    if ((HOOKS & HOOK_REGWRITE) && *changedReg != -1) {
+        HookRegWrite (h->pc, *changedReg, r[*changedReg]);
+    }
+    h->pc = next;
+    h->instrCount++;
+    return 1;
+}
+
+#undef HOOKS
+#undef VARIANT2
+#undef VARIANT
@@ -0,0 +1,30 @@
+
+/*
+ *  The eight variants of StepHart whose event mask has the octal high
+ *  digit HI; see stepbody.h.
+ */
+
+#define LO 0
+#include "stepbody.h"
+#undef LO
+#define LO 1
+#include "stepbody.h"
+#undef LO
+#define LO 2
+#include "stepbody.h"
+#undef LO
+#define LO 3
+#include "stepbody.h"
+#undef LO
+#define LO 4
+#include "stepbody.h"
+#undef LO
+#define LO 5
+#include "stepbody.h"
+#undef LO
+#define LO 6
+#include "stepbody.h"
+#undef LO
+#define LO 7
+#include "stepbody.h"
+#undef LO
@@ -0,0 +1,203 @@
+/*
+ *  superops: profile a workload corpus and write superops.h.
+ *
+ *      superops [-n COUNT] program.dump ... > superops.h
+ *
+ *  Every program runs on the functional engine, input from /dev/null,
+ *  and each run of two or three instructions that follow one another in
+ *  memory is counted by instruction kind.  Only sequences a fused handler
+ *  can run straight through qualify: no syscall, ll, sc or jal anywhere,
+ *  and a branch, jump or store only at the end.  All-zero words are left
+ *  out, as a program that runs off into cleared memory would otherwise
+ *  make its nops look like the hottest code.  The COUNT sequences that
+ *  would save the most dispatches are chosen greedily, a chosen triple
+ *  taking its runs from the pairs at its start and end, and written out
+ *  best first for decode.c to mark and engine.c to build handlers for.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "computer.h"
+#include "decode.h"
+#include "mipssim.h"
+#undef mips			/* gcc already has a def for mips */
+
+#define SUPERLIMIT 100000000	/* instructions profiled per program */
+#define MAXSUPEROPS 255		/* what img->super can number */
+
+typedef struct {
+    int length;
+    InstrKind kinds[3];
+    long count;
+} Sequence;
+
+static long pairs [NUMKINDS][NUMKINDS];
+static long triples [NUMKINDS][NUMKINDS][NUMKINDS];
+
+/* The last two instructions run, oldest first, or -1 */
+static int lastPc [2];
+static InstrKind lastKind [2];
+
+/* Kinds that may come before the end of a sequence */
+static int Leads (InstrKind k) {
+    return k <= K_SRL || (k >= K_ADDIU && k <= K_LUI) || k == K_LW;
+}
+
+/* Kinds that may end one */
+static int Ends (InstrKind k) {
+    return Leads (k) || k == K_JR || k == K_BEQ || k == K_BNE || k == K_SW
+        || k == K_J;
+}
+
+static int Record (MipsSim *m, int pc, int changedReg, int changedMem,
+    void *arg) {
+    int instr;
+    InstrKind kind;
+
+    if (MipsReadMem (m, pc, &instr) != 0) {
+        return 0;
+    }
+    if (instr == 0) {
+        /* Zeroed memory runs as sll $0,$0,0; not worth fusing */
+        lastPc[0] = lastPc[1] = -1;
+        return 0;
+    }
+    kind = KindOf ((instr >> 26) & 0x3f, instr & 0x3f);
+    if (Ends (kind) && lastPc[1] == pc - 4 && Leads (lastKind[1])) {
+        pairs[lastKind[1]][kind]++;
+        if (lastPc[0] == pc - 8 && Leads (lastKind[0])) {
+            triples[lastKind[0]][lastKind[1]][kind]++;
+        }
+    }
+    lastPc[0] = lastPc[1];
+    lastKind[0] = lastKind[1];
+    lastPc[1] = pc;
+    lastKind[1] = kind;
+    return 0;
+}
+
+/* Dispatches a sequence saves: all but one per run */
+static long Saved (const Sequence *s) {
+    return s->count * (s->length - 1);
+}
+
+/* Move the best of seqs[first] .. seqs[n-1] to seqs[first]. */
+static void Choose (Sequence *seqs, int first, int n) {
+    Sequence best;
+    int k, b = first;
+
+    for (k=first+1; k<n; k++) {
+        if (Saved (&seqs[k]) > Saved (&seqs[b])) {
+            b = k;
+        }
+    }
+    best = seqs[b];
+    seqs[b] = seqs[first];
+    seqs[first] = best;
+    if (best.length < 3) {
+        return;
+    }
+    for (k=first+1; k<n; k++) {
+        if (seqs[k].length == 2
+            && ((seqs[k].kinds[0] == best.kinds[0] && seqs[k].kinds[1] == best.kinds[1])
+                || (seqs[k].kinds[0] == best.kinds[1] && seqs[k].kinds[1] == best.kinds[2]))) {
+            seqs[k].count = seqs[k].count > best.count ? seqs[k].count - best.count : 0;
+        }
+    }
+}
+
+static void PrintKind (InstrKind k) {
+    const char *p;
+
+    for (p = kindNames[k]; *p != '\0'; p++) {
+        putchar (toupper (*p));
+    }
+}
+
+int main (int argc, char *argv[]) {
+    static Sequence seqs [NUMKINDS*NUMKINDS*(NUMKINDS+1)];
+    int numSeqs = 0, count = 8, argIndex = 1, a, b, c, k;
+    long instrs = 0;
+    MipsSim *m = MipsCreate ();
+    FILE *devNull = fopen ("/dev/null", "r+");
+
+    if (argIndex+1 < argc && strcmp (argv[argIndex], "-n") == 0) {
+        count = atoi (argv[argIndex+1]);
+        argIndex += 2;
+    }
+    if (argIndex == argc || count < 1 || count > MAXSUPEROPS) {
+        fprintf (stderr, "Usage: superops [-n COUNT] program.dump ...\n"
+            "COUNT is from 1 to %d.\n", MAXSUPEROPS);
+        exit (1);
+    }
+    if (m == NULL || devNull == NULL) {
+        fprintf (stderr, "Can't set up the profiling machine.\n");
+        exit (1);
+    }
+    MipsSetIO (m, devNull, devNull);
+    MipsSetStepHook (m, Record, NULL);
+    for (k=argIndex; k<argc; k++) {
+        if (MipsLoadFile (m, argv[k]) != MIPS_OK) {
+            fprintf (stderr, "Can't load %s.\n", argv[k]);
+            exit (1);
+        }
+        lastPc[0] = lastPc[1] = -1;
+        instrs += MipsStep (m, SUPERLIMIT);
+    }
+
+    for (a=0; a<NUMKINDS; a++) {
+        for (b=0; b<NUMKINDS; b++) {
+            if (pairs[a][b] > 0) {
+                seqs[numSeqs].length = 2;
+                seqs[numSeqs].kinds[0] = a;
+                seqs[numSeqs].kinds[1] = b;
+                seqs[numSeqs++].count = pairs[a][b];
+            }
+            for (c=0; c<NUMKINDS; c++) {
+                if (triples[a][b][c] > 0) {
+                    seqs[numSeqs].length = 3;
+                    seqs[numSeqs].kinds[0] = a;
+                    seqs[numSeqs].kinds[1] = b;
+                    seqs[numSeqs].kinds[2] = c;
+                    seqs[numSeqs++].count = triples[a][b][c];
+                }
+            }
+        }
+    }
+    for (k=0; k<numSeqs && k<count; k++) {
+        Choose (seqs, k, numSeqs);
+        if (seqs[k].count == 0) {
+            break;
+        }
+    }
+    numSeqs = k;
+
+    printf ("\n/*\n *  Superinstructions, generated by superops from\n *  %s",
+        argv[argIndex]);
+    for (k=argIndex+1; k<argc; k++) {
+        printf (" %s", argv[k]);
+    }
+    printf ("\n *  (%ld instructions); make superops.h.new redoes it.  Each is\n"
+        " *  X (n, length, kinds), a pair padded with NONE, best first; the\n"
+        " *  count is how often the sequence ran outside those before it.\n"
+        " */\n\n", instrs);
+    printf ("#define NUMSUPEROPS %d\n#define SUPEROPS(X)", numSeqs);
+    for (k=0; k<numSeqs; k++) {
+        printf (" \\\n    X (%d, %d, ", k, seqs[k].length);
+        PrintKind (seqs[k].kinds[0]);
+        printf (", ");
+        PrintKind (seqs[k].kinds[1]);
+        printf (", ");
+        if (seqs[k].length == 3) {
+            PrintKind (seqs[k].kinds[2]);
+        } else {
+            printf ("NONE");
+        }
+        printf (")\t/* %ld */", seqs[k].count);
+    }
+    printf ("\n");
+    MipsDestroy (m);
+    return 0;
+}
@@ -0,0 +1,19 @@
+
+/*
+ *  Superinstructions, generated by superops from
+ *  sample.dump lwSw.dump proc1.dump bench.dump
+ *  (1049662 instructions); make superops.h.new redoes it.  Each is
+ *  X (n, length, kinds), a pair padded with NONE, best first; the
+ *  count is how often the sequence ran outside those before it.
+ */
+
+#define NUMSUPEROPS 8
+#define SUPEROPS(X) \
+    X (0, 3, ADDIU, ADDU, BEQ)	/* 262144 */ \
+    X (1, 3, ADDU, ADDIU, BNE)	/* 9 */ \
+    X (2, 3, LW, ADDIU, BNE)	/* 5 */ \
+    X (3, 3, ADDU, ADDIU, J)	/* 3 */ \
+    X (4, 2, ADDU, ADDIU, NONE)	/* 3 */ \
+    X (5, 3, OR, ADDU, ADDIU)	/* 1 */ \
+    X (6, 3, ADDIU, ADDU, ADDIU)	/* 1 */ \
+    X (7, 3, ADDIU, OR, ADDU)	/* 1 */
@@ -0,0 +1,349 @@
+/*
+ *  traceanalyze: summarize a chunk trace written by sim --chunk-trace.
+ *
+ *      traceanalyze [-j THREADS] [-n PCS] [-r REG] trace
+ *
+ *  The chunk headers are read first to index the file, then THREADS
+ *  threads (one per core by default) take chunks in turn and decode each
+ *  from its own snapshot into private totals: instructions per pc,
+ *  writes and changes of each register, and writes to each memory word.
+ *  The totals are merged at the end, the latest chunk giving the final
+ *  values.  The report lists the PCS busiest pcs, every register and
+ *  every word written, and with -r the history of register REG, each
+ *  change with the instruction number and pc that made it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "computer.h"
+#include "chunktrace.h"
+
+#define WORDS (MAXNUMINSTRS+MAXNUMDATA)
+#define INDEX(addr) ((unsigned int) ((addr) - 0x00400000) / 4)
+
+typedef struct {
+    long instr;
+    int pc, value;
+} Change;
+
+/* What one thread, or the merge of all of them, found */
+typedef struct {
+    long instrs;
+    long pcCounts [WORDS];
+    long otherPcs;		/* instructions outside the image */
+    long regWrites [32], regChanges [32];
+    long regLastChange [32];	/* instruction number, 0 for never */
+    int regFinal [32];
+    long regFinalChunk [32];	/* chunk of the final value, -1 for none */
+    long memWrites [WORDS];
+    int memFinal [WORDS];
+    long memFinalChunk [WORDS];
+} Totals;
+
+/* Changes to the -r register in one chunk */
+typedef struct {
+    Change *changes;
+    int numChanges;
+} History;
+
+static unsigned char *trace;
+static long traceSize;
+static long *chunks;		/* offset of each chunk's header */
+static long numChunks;
+static long nextChunk;		/* the next chunk for a thread to take */
+static int historyReg = -1;
+static History *histories;	/* by chunk, with -r */
+
+static unsigned int Get32 (const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int) p[3] << 24;
+}
+
+static void Bad (long chunk) {
+    fprintf (stderr, "Chunk %ld of the trace is damaged.\n", chunk);
+    exit (1);
+}
+
+/* Find every chunk, checking only that each fits in the file. */
+static void Index () {
+    long offset = 8, max = 0;
+
+    if (traceSize < 8 || memcmp (trace, "MTRC", 4) != 0
+        || Get32 (trace+4) != CHUNKVERSION) {
+        fprintf (stderr, "Not a chunk trace.\n");
+        exit (1);
+    }
+    while (offset < traceSize) {
+        if (numChunks == max) {
+            max = max ? 2*max : 1024;
+            chunks = realloc (chunks, max * sizeof (long));
+            if (chunks == NULL) {
+                fprintf (stderr, "Out of memory for the chunk index.\n");
+                exit (1);
+            }
+        }
+        if (offset + CHUNKHEADER > traceSize || memcmp (trace+offset, "CHNK", 4) != 0
+            || offset + CHUNKHEADER + Get32 (trace+offset+8) > traceSize) {
+            Bad (numChunks);
+        }
+        chunks[numChunks++] = offset;
+        offset += CHUNKHEADER + Get32 (trace+offset+8);
+    }
+}
+
+/* Decode chunk c into t. */
+static void Decode (long c, Totals *t) {
+    const unsigned char *header = trace + chunks[c], *p = header + CHUNKHEADER;
+    const unsigned char *end = p + Get32 (header+8);
+    int records = Get32 (header+4), pc = Get32 (header+20), regs [32];
+    long instr = Get32 (header+12) | (long) Get32 (header+16) << 32;
+    int k, flags, reg, addr, value, maxChanges = 0;
+    History *h = historyReg >= 0 ? &histories[c] : NULL;
+
+    for (k=0; k<32; k++) {
+        regs[k] = Get32 (header+24+4*k);
+    }
+    for (; records>0; records--) {
+        if (p + 1 > end) {
+            Bad (c);
+        }
+        flags = *p++;
+        if (flags & CR_JUMP) {
+            if (p + 4 > end) {
+                Bad (c);
+            }
+            pc = Get32 (p);
+            p += 4;
+        }
+        instr++;
+        t->instrs++;
+        if (INDEX (pc) < WORDS) {
+            t->pcCounts[INDEX (pc)]++;
+        } else {
+            t->otherPcs++;
+        }
+        if (flags & CR_REG) {
+            if (p + 5 > end) {
+                Bad (c);
+            }
+            reg = *p++ & 31;
+            value = Get32 (p);
+            p += 4;
+            t->regWrites[reg]++;
+            if (value != regs[reg]) {
+                t->regChanges[reg]++;
+                t->regLastChange[reg] = instr;
+                if (reg == historyReg) {
+                    if (h->numChanges == maxChanges) {
+                        maxChanges = maxChanges ? 2*maxChanges : 256;
+                        h->changes = realloc (h->changes, maxChanges * sizeof (Change));
+                        if (h->changes == NULL) {
+                            fprintf (stderr, "Out of memory for the history.\n");
+                            exit (1);
+                        }
+                    }
+                    h->changes[h->numChanges].instr = instr;
+                    h->changes[h->numChanges].pc = pc;
+                    h->changes[h->numChanges++].value = value;
+                }
+            }
+            regs[reg] = value;
+            t->regFinal[reg] = value;
+            t->regFinalChunk[reg] = c;
+        }
+        if (flags & CR_MEM) {
+            if (p + 8 > end) {
+                Bad (c);
+            }
+            addr = Get32 (p);
+            value = Get32 (p+4);
+            p += 8;
+            if (INDEX (addr) < WORDS) {
+                t->memWrites[INDEX (addr)]++;
+                t->memFinal[INDEX (addr)] = value;
+                t->memFinalChunk[INDEX (addr)] = c;
+            }
+        }
+        pc += 4;
+    }
+    if (p != end) {
+        Bad (c);
+    }
+}
+
+static void *Worker (void *arg) {
+    Totals *t = arg;
+    long c;
+
+    while ((c = __atomic_fetch_add (&nextChunk, 1, __ATOMIC_RELAXED)) < numChunks) {
+        Decode (c, t);
+    }
+    return NULL;
+}
+
+static void Merge (Totals *into, const Totals *t) {
+    int k;
+
+    into->instrs += t->instrs;
+    into->otherPcs += t->otherPcs;
+    for (k=0; k<32; k++) {
+        into->regWrites[k] += t->regWrites[k];
+        into->regChanges[k] += t->regChanges[k];
+        if (t->regLastChange[k] > into->regLastChange[k]) {
+            into->regLastChange[k] = t->regLastChange[k];
+        }
+        if (t->regFinalChunk[k] > into->regFinalChunk[k]) {
+            into->regFinalChunk[k] = t->regFinalChunk[k];
+            into->regFinal[k] = t->regFinal[k];
+        }
+    }
+    for (k=0; k<WORDS; k++) {
+        into->pcCounts[k] += t->pcCounts[k];
+        into->memWrites[k] += t->memWrites[k];
+        if (t->memFinalChunk[k] > into->memFinalChunk[k]) {
+            into->memFinalChunk[k] = t->memFinalChunk[k];
+            into->memFinal[k] = t->memFinal[k];
+        }
+    }
+}
+
+static Totals *NewTotals () {
+    Totals *t = calloc (1, sizeof (Totals));
+    int k;
+
+    if (t == NULL) {
+        fprintf (stderr, "Out of memory for the totals.\n");
+        exit (1);
+    }
+    for (k=0; k<32; k++) {
+        t->regFinalChunk[k] = -1;
+    }
+    for (k=0; k<WORDS; k++) {
+        t->memFinalChunk[k] = -1;
+    }
+    return t;
+}
+
+static long *counts;
+
+static int CompareCounts (const void *a, const void *b) {
+    long x = counts[*(const int *) a], y = counts[*(const int *) b];
+    return (y > x) - (y < x);
+}
+
+static void Report (Totals *t, int numThreads, int numPcs) {
+    static int order [WORDS];
+    int k, n = 0;
+    long c;
+    History *h;
+
+    printf ("%ld instructions in %ld chunks, %d threads\n", t->instrs, numChunks,
+        numThreads);
+    for (k=0; k<WORDS; k++) {
+        if (t->pcCounts[k] > 0) {
+            order[n++] = k;
+        }
+    }
+    counts = t->pcCounts;
+    qsort (order, n, sizeof (int), CompareCounts);
+    printf ("Busiest pcs:\n");
+    for (k=0; k<n && k<numPcs; k++) {
+        printf ("  %8.8x  %ld  %.1f%%\n", 0x00400000 + 4*order[k],
+            t->pcCounts[order[k]], 100.0 * t->pcCounts[order[k]] / t->instrs);
+    }
+    if (t->otherPcs > 0) {
+        printf ("  outside the image  %ld\n", t->otherPcs);
+    }
+    printf ("Registers:\n");
+    for (k=0; k<32; k++) {
+        if (t->regWrites[k] > 0) {
+            printf ("  r%2.2d  %ld writes, %ld changes, last at %ld, final %8.8x\n",
+                k, t->regWrites[k], t->regChanges[k], t->regLastChange[k],
+                t->regFinal[k]);
+        }
+    }
+    printf ("Memory written:\n");
+    for (k=0; k<WORDS; k++) {
+        if (t->memWrites[k] > 0) {
+            printf ("  %8.8x  %ld writes, final %8.8x\n", 0x00400000 + 4*k,
+                t->memWrites[k], t->memFinal[k]);
+        }
+    }
+    if (historyReg < 0) {
+        return;
+    }
+    printf ("History of r%2.2d:\n", historyReg);
+    for (c=0; c<numChunks; c++) {
+        h = &histories[c];
+        for (k=0; k<h->numChanges; k++) {
+            printf ("  %ld  %8.8x  %8.8x\n", h->changes[k].instr, h->changes[k].pc,
+                h->changes[k].value);
+        }
+    }
+}
+
+int main (int argc, char *argv[]) {
+    int numThreads = sysconf (_SC_NPROCESSORS_ONLN), numPcs = 20, argIndex, k, fd;
+    pthread_t *threads;
+    Totals **totals, *all;
+    struct stat st;
+
+    for (argIndex=1; argIndex+1<argc && argv[argIndex][0] == '-'; argIndex+=2) {
+        if (strcmp (argv[argIndex], "-j") == 0) {
+            numThreads = atoi (argv[argIndex+1]);
+        } else if (strcmp (argv[argIndex], "-n") == 0) {
+            numPcs = atoi (argv[argIndex+1]);
+        } else if (strcmp (argv[argIndex], "-r") == 0) {
+            historyReg = atoi (argv[argIndex+1]);
+        } else {
+            break;
+        }
+    }
+    if (argIndex != argc-1 || numThreads < 1 || historyReg > 31) {
+        fprintf (stderr, "Usage: traceanalyze [-j THREADS] [-n PCS] [-r REG] trace\n");
+        exit (1);
+    }
+    fd = open (argv[argIndex], O_RDONLY);
+    if (fd < 0 || fstat (fd, &st) != 0) {
+        fprintf (stderr, "Can't open file: %s\n", argv[argIndex]);
+        exit (1);
+    }
+    traceSize = st.st_size;
+    trace = mmap (NULL, traceSize > 0 ? traceSize : 1, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (trace == MAP_FAILED) {
+        fprintf (stderr, "Can't map file: %s\n", argv[argIndex]);
+        exit (1);
+    }
+    Index ();
+    if (numThreads > numChunks) {
+        numThreads = numChunks > 0 ? numChunks : 1;
+    }
+    if (historyReg >= 0) {
+        histories = calloc (numChunks + 1, sizeof (History));
+    }
+    threads = malloc (numThreads * sizeof (pthread_t));
+    totals = malloc (numThreads * sizeof (Totals *));
+    if (threads == NULL || totals == NULL || (historyReg >= 0 && histories == NULL)) {
+        fprintf (stderr, "Out of memory for the threads.\n");
+        exit (1);
+    }
+    for (k=0; k<numThreads; k++) {
+        totals[k] = NewTotals ();
+        if (pthread_create (&threads[k], NULL, Worker, totals[k]) != 0) {
+            fprintf (stderr, "Can't start a thread.\n");
+            exit (1);
+        }
+    }
+    all = NewTotals ();
+    for (k=0; k<numThreads; k++) {
+        pthread_join (threads[k], NULL);
+        Merge (all, totals[k]);
+    }
+    Report (all, numThreads, numPcs);
+    return 0;
+}
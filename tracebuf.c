@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "tracebuf.h"
+
+/* Room kept free for the longest single item (a number) */
+#define SLACK 16
+
+static char *buf;
+static int used = 0;
+static char hexPairs[256][2];	/* "00" .. "ff" */
+static char decPairs[100][2];	/* "00" .. "99" */
+
+/* The writer thread's ring; buf is slots[head % TRACESLOTS] */
+static int policy = TRACE_SYNC;
+static char *slots[TRACESLOTS];
+static int lengths[TRACESLOTS];
+static unsigned long head, tail;	/* buffers handed over, and written */
+static int stopping;
+static long droppedLines;
+static pthread_t writer;
+
+void InitTrace () {
+    static const char digits[] = "0123456789abcdef";
+    int k;
+
+    buf = malloc (TRACEBUFSIZE);
+    if (buf == NULL) {
+        fprintf (stderr, "Out of memory for the trace buffer.\n");
+        exit (1);
+    }
+    for (k=0; k<256; k++) {
+        hexPairs[k][0] = digits[k >> 4];
+        hexPairs[k][1] = digits[k & 0xf];
+    }
+    for (k=0; k<100; k++) {
+        decPairs[k][0] = '0' + k / 10;
+        decPairs[k][1] = '0' + k % 10;
+    }
+    atexit (TraceFlush);
+}
+
+static void WriteAll (const char *p, int length) {
+    int k = 0, n;
+
+    while (k < length) {
+        n = write (1, p + k, length - k);
+        if (n < 0 && errno != EINTR) {
+            break;
+        }
+        if (n > 0) {
+            k += n;
+        }
+    }
+}
+
+/* Wait a little for the other side of the ring. */
+static void Pause () {
+    struct timespec t = { 0, 20000 };
+
+    nanosleep (&t, NULL);
+}
+
+static void *Writer (void *arg) {
+    unsigned long t = 0;
+
+    while (1) {
+        if (t == __atomic_load_n (&head, __ATOMIC_ACQUIRE)) {
+            if (__atomic_load_n (&stopping, __ATOMIC_ACQUIRE)
+                && t == __atomic_load_n (&head, __ATOMIC_ACQUIRE)) {
+                return NULL;
+            }
+            Pause ();
+            continue;
+        }
+        WriteAll (slots[t % TRACESLOTS], lengths[t % TRACESLOTS]);
+        __atomic_store_n (&tail, ++t, __ATOMIC_RELEASE);
+    }
+}
+
+/* Hand over the first length bytes of buf, keeping the rest for the next. */
+static void Publish (int length) {
+    char *next;
+
+    while (head + 1 - __atomic_load_n (&tail, __ATOMIC_ACQUIRE) >= TRACESLOTS) {
+        Pause ();
+    }
+    next = slots[(head + 1) % TRACESLOTS];
+    memcpy (next, buf + length, used - length);
+    lengths[head % TRACESLOTS] = length;
+    __atomic_store_n (&head, head + 1, __ATOMIC_RELEASE);
+    buf = next;
+    used -= length;
+}
+
+static void Drain () {
+    while (__atomic_load_n (&tail, __ATOMIC_ACQUIRE) != head) {
+        Pause ();
+    }
+}
+
+/*
+ *  Write out everything traced so far.  Anything printed with stdio
+ *  since the last flush is older than the buffer, so it goes first.
+ */
+void TraceFlush () {
+    if (policy != TRACE_SYNC) {
+        Drain ();
+        fflush (stdout);
+        if (used > 0) {
+            Publish (used);
+        }
+        Drain ();
+        return;
+    }
+    fflush (stdout);
+    WriteAll (buf, used);
+    used = 0;
+}
+
+/*
+ *  The buffer is full.  Without the writer thread, flush it.  Dropping,
+ *  only whole lines go, so the trace shows records or nothing.
+ */
+static void Spill () {
+    char *p;
+    int length = used;
+
+    if (policy == TRACE_SYNC) {
+        TraceFlush ();
+        return;
+    }
+    if (policy == TRACE_DROP) {
+        for (p = buf + used; p > buf && p[-1] != '\n'; p--) {
+        }
+        length = p > buf ? p - buf : used;
+        if (head + 1 - __atomic_load_n (&tail, __ATOMIC_ACQUIRE) >= TRACESLOTS) {
+            for (p = buf; (p = memchr (p, '\n', buf + length - p)) != NULL; p++) {
+                droppedLines++;
+            }
+            memmove (buf, buf + length, used - length);
+            used -= length;
+            return;
+        }
+    }
+    Publish (length);
+}
+
+static void StopTraceWriter () {
+    TraceFlush ();
+    __atomic_store_n (&stopping, 1, __ATOMIC_RELEASE);
+    pthread_join (writer, NULL);
+    policy = TRACE_SYNC;
+    if (droppedLines > 0) {
+        fprintf (stderr, "Dropped %ld trace lines with the writer behind.\n",
+            droppedLines);
+    }
+}
+
+/* Write the trace from a thread of its own, by policy when it falls behind. */
+void StartTraceWriter (int p) {
+    int k;
+
+    slots[0] = buf;
+    for (k=1; k<TRACESLOTS; k++) {
+        slots[k] = malloc (TRACEBUFSIZE);
+        if (slots[k] == NULL) {
+            fprintf (stderr, "Out of memory for the trace buffer.\n");
+            exit (1);
+        }
+    }
+    policy = p;
+    if (pthread_create (&writer, NULL, Writer, NULL) != 0) {
+        fprintf (stderr, "Can't start the trace writer.\n");
+        exit (1);
+    }
+    atexit (StopTraceWriter);
+}
+
+static void Reserve (int n) {
+    if (used + n > TRACEBUFSIZE) {
+        Spill ();
+    }
+}
+
+void TraceStr (const char *s) {
+    int n = strlen (s);
+
+    if (n > TRACEBUFSIZE - SLACK) {
+        TraceFlush ();
+        fputs (s, stdout);
+        return;
+    }
+    Reserve (n);
+    memcpy (buf + used, s, n);
+    used += n;
+}
+
+void TraceChar (char c) {
+    Reserve (1);
+    buf[used++] = c;
+}
+
+void TraceHex (unsigned int x) {
+    char *p;
+
+    Reserve (8);
+    p = buf + used;
+    memcpy (p, hexPairs[x >> 24], 2);
+    memcpy (p + 2, hexPairs[(x >> 16) & 0xff], 2);
+    memcpy (p + 4, hexPairs[(x >> 8) & 0xff], 2);
+    memcpy (p + 6, hexPairs[x & 0xff], 2);
+    used += 8;
+}
+
+void TraceUns (unsigned int x) {
+    char tmp[SLACK];
+    int n = SLACK;
+
+    /* two digits at a time, from the right */
+    while (x >= 100) {
+        n -= 2;
+        memcpy (tmp + n, decPairs[x % 100], 2);
+        x /= 100;
+    }
+    if (x >= 10) {
+        n -= 2;
+        memcpy (tmp + n, decPairs[x], 2);
+    } else {
+        tmp[--n] = '0' + x;
+    }
+    Reserve (SLACK - n);
+    memcpy (buf + used, tmp + n, SLACK - n);
+    used += SLACK - n;
+}
+
+void TraceInt (int x) {
+    if (x < 0) {
+        TraceChar ('-');
+        TraceUns (-(unsigned int) x);
+    } else {
+        TraceUns (x);
+    }
+}
+
+void TraceDec2 (int x) {
+    if (x >= 0 && x < 100) {
+        Reserve (2);
+        memcpy (buf + used, decPairs[x], 2);
+        used += 2;
+    } else if (x < 0 && x > -10) {
+        TraceChar ('-');
+        TraceChar ('0');
+        TraceChar ('0' - x);
+    } else {
+        TraceInt (x);
+    }
+}
@@ -0,0 +1,32 @@
+
+/*
+ *  Trace writer.  The trace is rendered with table-driven formatters into
+ *  one large buffer and handed to the kernel with a single write(2) when
+ *  the buffer fills, before input is read, and at exit.  The formatters
+ *  produce exactly what the printf conversions they replace did.
+ *
+ *  With a writer thread started, the buffer is one of a single-producer
+ *  single-consumer ring of TRACESLOTS buffers: a full one is handed to
+ *  the thread, which does the write, and rendering goes on in the next,
+ *  so simulation and output overlap.  When every buffer is taken the
+ *  simulator either waits (TRACE_BLOCK) or drops the complete lines of
+ *  the current one and counts them (TRACE_DROP).  A flush still waits
+ *  until everything is written.
+ */
+
+#define TRACEBUFSIZE (1<<20)
+#define TRACESLOTS 4		/* buffers in the writer thread's ring */
+
+#define TRACE_SYNC 0
+#define TRACE_BLOCK 1
+#define TRACE_DROP 2
+
+void InitTrace ();
+void TraceStr (const char *s);
+void TraceChar (char c);
+void TraceHex (unsigned int x);		/* %8.8x */
+void TraceDec2 (int x);			/* %2.2d */
+void TraceInt (int x);			/* %d */
+void TraceUns (unsigned int x);		/* %u */
+void TraceFlush ();
+void StartTraceWriter (int policy);
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "computer.h"
+#include "decode.h"
+#include "undo.h"
+#include "filter.h"
+#undef mips			/* gcc already has a def for mips */
+
+extern Computer mips;
+
+typedef struct {
+    long instrCount;
+    int pc;
+    int registers [32];
+    int memory [MAXNUMINSTRS+MAXNUMDATA];
+} Checkpoint;
+
+int undoLogging = 0;
+int undoReplaying = 0;	/* history is being re-executed */
+
+static UndoEntry *undoLog;
+static int undoHead;		/* slot the next entry goes in */
+static int undoCount;		/* valid entries behind undoHead */
+static UndoEntry pending;	/* entry for the instruction being simulated */
+static int savedRegs [32];	/* registers before that instruction */
+
+static Checkpoint *checkpoints;
+static int numCheckpoints;
+static long interval;
+
+/* Values read by syscall 5, so re-execution does not read them again */
+typedef struct {
+    long instrCount;
+    int value;
+} InputEntry;
+static InputEntry *inputs;
+static int numInputs, maxInputs;
+
+void InitUndo () {
+    undoLog = malloc (UNDOLOGSIZE * sizeof (UndoEntry));
+    checkpoints = malloc (MAXCHECKPOINTS * sizeof (Checkpoint));
+    if (undoLog == NULL || checkpoints == NULL) {
+        fprintf (stderr, "Out of memory for the undo log.\n");
+        exit (1);
+    }
+    undoLogging = 1;
+}
+
+static void TakeCheckpoint () {
+    Checkpoint *c;
+    int k;
+
+    if (numCheckpoints == MAXCHECKPOINTS) {
+        /* Thin out: keep every other checkpoint, and space them further */
+        for (k=0; 2*k<MAXCHECKPOINTS; k++) {
+            checkpoints[k] = checkpoints[2*k];
+        }
+        numCheckpoints = MAXCHECKPOINTS/2;
+        interval *= 2;
+    }
+    c = &checkpoints[numCheckpoints++];
+    c->instrCount = mips.instrCount;
+    c->pc = mips.pc;
+    memcpy (c->registers, mips.registers, sizeof (c->registers));
+    memcpy (c->memory, mips.memory, sizeof (c->memory));
+}
+
+/*
+ *  Forget all history and checkpoint the current state as the point
+ *  the run can be taken back to.
+ */
+void UndoReset () {
+    undoHead = 0;
+    undoCount = 0;
+    numCheckpoints = 0;
+    numInputs = 0;
+    interval = CHECKPOINTINTERVAL;
+    TakeCheckpoint ();
+}
+
+/* Called before an instruction is executed. */
+void UndoBegin () {
+    pending.pc = mips.pc;
+    pending.mem = -1;
+    memcpy (savedRegs, mips.registers, sizeof (savedRegs));
+}
+
+/* Called before the memory stage, with the address Execute computed. */
+void UndoBeforeMem (DecodedInstr* d, int addr) {
+    if ((d->op == 0x2b || d->op == 0x38) && INIMAGE (addr)) {
+        pending.mem = addr;
+        pending.memVal = mips.memory[(addr-0x00400000)/4];
+    }
+}
+
+/* Called once the instruction is complete. */
+void UndoCommit (int changedReg, int changedMem) {
+    pending.reg = changedReg;
+    if (changedReg != -1) {
+        pending.regVal = savedRegs[changedReg];
+    }
+    if (changedMem == -1) {
+        pending.mem = -1;
+    }
+    undoLog[undoHead] = pending;
+    undoHead = (undoHead + 1) & (UNDOLOGSIZE - 1);
+    if (undoCount < UNDOLOGSIZE) {
+        undoCount++;
+    }
+    if (mips.instrCount % interval == 0) {
+        TakeCheckpoint ();
+    }
+}
+
+/* The value syscall 5 read the first time, while history is re-executed */
+int ReplayedInput () {
+    int lo = 0, hi = numInputs;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (inputs[mid].instrCount < mips.instrCount) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < numInputs && inputs[lo].instrCount == mips.instrCount) {
+        return inputs[lo].value;
+    }
+    return 0;
+}
+
+/* Remember the value syscall 5 read for the instruction being simulated. */
+void LogInput (int value) {
+    /* drop anything recorded in a future we have stepped back from */
+    while (numInputs > 0 && inputs[numInputs-1].instrCount >= mips.instrCount) {
+        numInputs--;
+    }
+    if (numInputs == maxInputs) {
+        maxInputs = maxInputs ? 2*maxInputs : 64;
+        inputs = realloc (inputs, maxInputs * sizeof (InputEntry));
+        if (inputs == NULL) {
+            fprintf (stderr, "Out of memory for the undo log.\n");
+            exit (1);
+        }
+    }
+    inputs[numInputs].instrCount = mips.instrCount;
+    inputs[numInputs].value = value;
+    numInputs++;
+}
+
+/* Undo the most recent instruction in the log.  Returns its entry. */
+static UndoEntry *Undo () {
+    UndoEntry *e;
+
+    undoHead = (undoHead - 1) & (UNDOLOGSIZE - 1);
+    undoCount--;
+    e = &undoLog[undoHead];
+    if (e->reg != -1) {
+        mips.registers[e->reg] = e->regVal;
+    }
+    if (e->mem != -1) {
+        mips.memory[(e->mem-0x00400000)/4] = e->memVal;
+    }
+    mips.pc = e->pc;
+    mips.instrCount--;
+    return e;
+}
+
+/* Restore the latest checkpoint taken at or before instruction target. */
+static Checkpoint *Restore (long target) {
+    Checkpoint *c;
+
+    while (numCheckpoints > 1
+           && checkpoints[numCheckpoints-1].instrCount > target) {
+        numCheckpoints--;
+    }
+    c = &checkpoints[numCheckpoints-1];
+    mips.instrCount = c->instrCount;
+    mips.pc = c->pc;
+    memcpy (mips.registers, c->registers, sizeof (c->registers));
+    memcpy (mips.memory, c->memory, sizeof (c->memory));
+    undoHead = 0;
+    undoCount = 0;
+    return c;
+}
+
+/*
+ *  Re-execute silently up to instruction target.  If lastHit is not NULL,
+ *  set it to the last instruction number before target that started at a
+ *  breakpoint (left alone if there is none).
+ */
+static void Replay (long target, long *lastHit) {
+    int wasSilent = silent;
+    int changedReg, changedMem;
+
+    silent = 1;
+    undoReplaying = 1;
+    while (mips.instrCount < target) {
+        if (lastHit != NULL && IsBreakpoint (mips.pc)) {
+            *lastHit = mips.instrCount;
+        }
+        if (!Step (&changedReg, &changedMem)) {
+            break;
+        }
+    }
+    undoReplaying = 0;
+    silent = wasSilent;
+}
+
+/* Take the machine back to the state before instruction target. */
+static void GoTo (long target) {
+    if (mips.instrCount - target <= undoCount) {
+        while (mips.instrCount > target) {
+            Undo ();
+        }
+    } else {
+        Restore (target);
+        Replay (target, NULL);
+    }
+}
+
+void StepBack (long n) {
+    long target = mips.instrCount - n;
+
+    GoTo (target < 0 ? 0 : target);
+    printf ("Back at instruction %ld, pc = %8.8x\n", mips.instrCount, mips.pc);
+}
+
+/*
+ *  Go back to the most recent point where the pc was at a breakpoint,
+ *  or to the start of the run if there is none.
+ */
+void ReverseContinue () {
+    long end, hit = -1;
+    Checkpoint *c;
+
+    while (undoCount > 0) {
+        if (IsBreakpoint (Undo ()->pc)) {
+            printf ("Breakpoint at %8.8x, instruction %ld\n",
+                mips.pc, mips.instrCount);
+            return;
+        }
+    }
+    /* Older history: search each checkpoint interval, newest first */
+    end = mips.instrCount;
+    while (end > 0 && hit == -1) {
+        c = Restore (end - 1);
+        Replay (end, &hit);
+        end = c->instrCount;
+    }
+    if (hit == -1) {
+        GoTo (0);
+        printf ("Back at start, pc = %8.8x\n", mips.pc);
+    } else {
+        GoTo (hit);
+        printf ("Breakpoint at %8.8x, instruction %ld\n",
+            mips.pc, mips.instrCount);
+    }
+}
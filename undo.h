@@ -0,0 +1,32 @@
+
+/*
+ *  Execution history for stepping backwards.  Every simulated instruction
+ *  logs the old value of the register and memory word it changed in a
+ *  ring buffer; full checkpoints of the machine are taken periodically so
+ *  that points older than the ring can be reached by re-execution.
+ */
+
+#define UNDOLOGSIZE 65536	/* entries in the undo ring, a power of two */
+#define MAXCHECKPOINTS 16	/* full-state checkpoints kept at once */
+#define CHECKPOINTINTERVAL 4096	/* initial instructions between checkpoints */
+
+typedef struct {
+    int pc;		/* pc of the instruction */
+    int reg;		/* register it changed, otherwise -1 */
+    int regVal;		/* old contents of that register */
+    int mem;		/* address of memory it changed, otherwise -1 */
+    int memVal;		/* old contents of that word */
+} UndoEntry;
+
+extern int undoLogging;
+extern int undoReplaying;
+
+void InitUndo ();
+void UndoReset ();
+void UndoBegin ();
+void UndoBeforeMem (DecodedInstr*, int addr);
+void UndoCommit (int changedReg, int changedMem);
+int ReplayedInput ();
+void LogInput (int value);
+void StepBack (long n);
+void ReverseContinue ();